@@ -13,6 +13,8 @@
 
 #include "vast/bitmap.hpp"
 
+#include <algorithm>
+
 namespace vast {
 
 bitmap::bitmap() : bitmap_{default_bitmap{}} {
@@ -54,8 +56,43 @@ const bitmap::variant& bitmap::get_data() const {
   return bitmap_;
 }
 
+namespace {
+
+// Compares two bit ranges of possibly different encodings sequence by
+// sequence.
+template <class LHS, class RHS>
+bool equal_bits(const LHS& lhs, const RHS& rhs) {
+  using word_type = bitmap::word_type;
+  if (lhs.size() != rhs.size())
+    return false;
+  auto lhs_range = bit_range(lhs);
+  auto rhs_range = bit_range(rhs);
+  auto lhs_begin = lhs_range.begin();
+  auto rhs_begin = rhs_range.begin();
+  auto lhs_bits = lhs.empty() ? bitmap::bits_type{} : *lhs_begin++;
+  auto rhs_bits = rhs.empty() ? bitmap::bits_type{} : *rhs_begin++;
+  while (!lhs_bits.empty() && !rhs_bits.empty()) {
+    auto n = std::min(lhs_bits.size(), rhs_bits.size());
+    auto mask = n < word_type::width ? word_type::lsb_mask(n) : word_type::all;
+    if (((lhs_bits.data() ^ rhs_bits.data()) & mask) != 0)
+      return false;
+    lhs_bits = drop(lhs_bits, n);
+    rhs_bits = drop(rhs_bits, n);
+    if (lhs_bits.empty() && lhs_begin != lhs_range.end())
+      lhs_bits = *lhs_begin++;
+    if (rhs_bits.empty() && rhs_begin != rhs_range.end())
+      rhs_bits = *rhs_begin++;
+  }
+  return true;
+}
+
+} // namespace <anonymous>
+
 bool operator==(const bitmap& x, const bitmap& y) {
-  return x.bitmap_ == y.bitmap_;
+  if (x.bitmap_.index() == y.bitmap_.index())
+    return x.bitmap_ == y.bitmap_;
+  auto f = [](auto& lhs, auto& rhs) { return equal_bits(lhs, rhs); };
+  return caf::visit(f, x.bitmap_, y.bitmap_);
 }
 
 bitmap_bit_range::bitmap_bit_range(const bitmap& bm) {
@@ -84,4 +121,54 @@ bitmap_bit_range bit_range(const bitmap& bm) {
   return bitmap_bit_range{bm};
 }
 
+namespace {
+
+// Returns the Roaring bitmap held by a bitmap, or converts it into buffer.
+const roaring_bitmap& as_roaring(const bitmap& bm, roaring_bitmap& buffer) {
+  if (auto x = caf::get_if<roaring_bitmap>(&bm))
+    return *x;
+  buffer.append(bm);
+  return buffer;
+}
+
+template <bool FillLHS, bool FillRHS, class Operation>
+bitmap dispatch(const bitmap& lhs, const bitmap& rhs,
+                detail::block_operation op, Operation f) {
+  auto x = caf::get_if<ewah_bitmap>(&lhs);
+  auto y = caf::get_if<ewah_bitmap>(&rhs);
+  if (x != nullptr && y != nullptr)
+    return binary_eval(*x, *y, op);
+  if (caf::holds_alternative<roaring_bitmap>(lhs)
+      || caf::holds_alternative<roaring_bitmap>(rhs)) {
+    roaring_bitmap lhs_buffer;
+    roaring_bitmap rhs_buffer;
+    return binary_eval(as_roaring(lhs, lhs_buffer),
+                       as_roaring(rhs, rhs_buffer), op);
+  }
+  return binary_eval<FillLHS, FillRHS>(lhs, rhs, f);
+}
+
+} // namespace <anonymous>
+
+bitmap binary_and(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto x, auto y) { return x & y; };
+  return dispatch<false, false>(lhs, rhs, detail::block_operation::and_op, f);
+}
+
+bitmap binary_or(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto x, auto y) { return x | y; };
+  return dispatch<true, true>(lhs, rhs, detail::block_operation::or_op, f);
+}
+
+bitmap binary_xor(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto x, auto y) { return x ^ y; };
+  return dispatch<true, true>(lhs, rhs, detail::block_operation::xor_op, f);
+}
+
+bitmap binary_nand(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto x, auto y) { return x & ~y; };
+  return dispatch<true, false>(lhs, rhs, detail::block_operation::and_not_op,
+                               f);
+}
+
 } // namespace vast
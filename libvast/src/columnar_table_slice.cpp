@@ -0,0 +1,168 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/columnar_table_slice.hpp"
+
+#include <string_view>
+#include <type_traits>
+
+#include <caf/deserializer.hpp>
+#include <caf/serializer.hpp>
+
+#include "vast/packed_table_slice.hpp"
+#include "vast/type.hpp"
+#include "vast/value_index.hpp"
+
+#include "vast/detail/assert.hpp"
+#include "vast/detail/overload.hpp"
+
+namespace vast {
+
+namespace {
+
+template <class T>
+data_view value_at(const std::vector<T>& xs, size_t row) {
+  return make_view(xs[row]);
+}
+
+data_view value_at(const std::vector<uint8_t>& xs, size_t row) {
+  return xs[row] != 0;
+}
+
+data_view value_at(const columnar_table_slice::string_array& xs, size_t row) {
+  auto first = row == 0 ? uint64_t{0} : xs.offsets[row - 1];
+  return std::string_view{xs.bytes.data() + first, xs.offsets[row] - first};
+}
+
+data_view value_at(const columnar_table_slice::encoded_array& xs,
+                   size_t row) {
+  auto first = row == 0 ? uint64_t{0} : xs.offsets[row - 1];
+  return packed_table_slice::decode(xs.bytes.data() + first,
+                                    xs.offsets[row] - first);
+}
+
+template <class Array>
+std::vector<data_view> views(const Array& xs, const bitvector<uint64_t>& valid,
+                             size_t rows) {
+  std::vector<data_view> result;
+  result.reserve(rows);
+  for (size_t row = 0; row < rows; ++row)
+    result.push_back(valid[row] ? value_at(xs, row) : data_view{caf::none});
+  return result;
+}
+
+} // namespace <anonymous>
+
+table_slice_ptr columnar_table_slice::make(table_slice_header header) {
+  return table_slice_ptr{new columnar_table_slice{std::move(header)}, false};
+}
+
+columnar_table_slice::array columnar_table_slice::make_array(const type& t) {
+  if (holds_alternative<boolean_type>(t))
+    return std::vector<uint8_t>{};
+  if (holds_alternative<integer_type>(t))
+    return std::vector<integer>{};
+  if (holds_alternative<count_type>(t))
+    return std::vector<count>{};
+  if (holds_alternative<real_type>(t))
+    return std::vector<real>{};
+  if (holds_alternative<timespan_type>(t))
+    return std::vector<timespan>{};
+  if (holds_alternative<timestamp_type>(t))
+    return std::vector<timestamp>{};
+  if (holds_alternative<port_type>(t))
+    return std::vector<port>{};
+  if (holds_alternative<address_type>(t))
+    return std::vector<address>{};
+  if (holds_alternative<string_type>(t))
+    return string_array{};
+  return encoded_array{};
+}
+
+columnar_table_slice* columnar_table_slice::copy() const {
+  return new columnar_table_slice(*this);
+}
+
+caf::error columnar_table_slice::serialize(caf::serializer& sink) const {
+  return sink(columns_);
+}
+
+caf::error columnar_table_slice::deserialize(caf::deserializer& source) {
+  return source(columns_);
+}
+
+void columnar_table_slice::append_column_to_index(size_type col,
+                                                  value_index& idx) const {
+  VAST_ASSERT(col < columns());
+  auto& x = columns_[col];
+  // Hand typed arrays to the index as a whole and materialize views only for
+  // the remaining columns.
+  column_batch batch;
+  batch.valid = &x.valid;
+  auto f = detail::overload(
+    [&](const auto& xs) {
+      using value_type = typename std::decay_t<decltype(xs)>::value_type;
+      batch.values = span<const value_type>{xs};
+    },
+    [&](const std::vector<uint8_t>& xs) {
+      batch.values = views(xs, x.valid, rows());
+    },
+    [&](const string_array& xs) { batch.values = views(xs, x.valid, rows()); },
+    [&](const encoded_array& xs) {
+      batch.values = views(xs, x.valid, rows());
+    });
+  caf::visit(f, x.values);
+  idx.append(batch, offset());
+}
+
+data_view columnar_table_slice::at(size_type row, size_type col) const {
+  VAST_ASSERT(row < rows());
+  VAST_ASSERT(col < columns());
+  auto& x = columns_[col];
+  if (!x.valid[row])
+    return caf::none;
+  return caf::visit([&](const auto& xs) { return value_at(xs, row); },
+                    x.values);
+}
+
+caf::atom_value columnar_table_slice::implementation_id() const noexcept {
+  return class_id;
+}
+
+columnar_table_slice::columnar_table_slice(table_slice_header header)
+  : table_slice{std::move(header)} {
+  // nop
+}
+
+columnar_table_slice::~columnar_table_slice() {
+  if (pool_ == nullptr)
+    return;
+  // Empty the columns but keep their buffers for the next slice.
+  auto f = detail::overload(
+    [](string_array& xs) {
+      xs.offsets.clear();
+      xs.bytes.clear();
+    },
+    [](encoded_array& xs) {
+      xs.offsets.clear();
+      xs.bytes.clear();
+    },
+    [](auto& xs) { xs.clear(); });
+  for (auto& x : columns_) {
+    x.valid.clear();
+    caf::visit(f, x.values);
+  }
+  pool_->release(std::move(columns_));
+}
+
+} // namespace vast
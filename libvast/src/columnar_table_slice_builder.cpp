@@ -0,0 +1,158 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/columnar_table_slice_builder.hpp"
+
+#include <type_traits>
+#include <utility>
+
+#include <caf/make_counted.hpp>
+
+#include "vast/packed_table_slice.hpp"
+#include "vast/type.hpp"
+
+#include "vast/detail/overload.hpp"
+
+namespace vast {
+
+caf::atom_value columnar_table_slice_builder::get_implementation_id() noexcept {
+  return columnar_table_slice::class_id;
+}
+
+columnar_table_slice_builder::columnar_table_slice_builder(record_type layout)
+  : super{std::move(layout)},
+    col_{0},
+    rows_{0},
+    columns_(columns()),
+    pool_{caf::make_counted<columnar_table_slice::pool_type>(
+      max_recycled_slices)} {
+  VAST_ASSERT(!columns_.empty());
+  reset_columns();
+}
+
+columnar_table_slice_builder::~columnar_table_slice_builder() {
+  // nop
+}
+
+table_slice_builder_ptr columnar_table_slice_builder::make(record_type layout) {
+  return caf::make_counted<columnar_table_slice_builder>(std::move(layout));
+}
+
+bool columnar_table_slice_builder::add(data_view x) {
+  if (!type_check(layout().fields[col_].type, x))
+    return false;
+  auto& column = columns_[col_];
+  column.valid.push_back(!caf::holds_alternative<caf::none_t>(x));
+  // Nil cells leave a default-constructed placeholder in the typed arrays and
+  // an empty range in the byte buffers.
+  auto f = detail::overload(
+    [&](std::vector<uint8_t>& xs) {
+      auto y = caf::get_if<view<boolean>>(&x);
+      xs.push_back(y != nullptr && *y ? 1 : 0);
+    },
+    [&](columnar_table_slice::string_array& xs) {
+      if (auto y = caf::get_if<view<std::string>>(&x))
+        xs.bytes.append(y->data(), y->size());
+      xs.offsets.push_back(xs.bytes.size());
+    },
+    [&](columnar_table_slice::encoded_array& xs) {
+      if (!caf::holds_alternative<caf::none_t>(x))
+        packed_table_slice::encode(xs.bytes, x);
+      xs.offsets.push_back(xs.bytes.size());
+    },
+    [&](auto& xs) {
+      using value_type = typename std::decay_t<decltype(xs)>::value_type;
+      if (auto y = caf::get_if<view<value_type>>(&x))
+        xs.push_back(*y);
+      else
+        xs.emplace_back();
+    });
+  caf::visit(f, column.values);
+  if (++col_ == columns()) {
+    ++rows_;
+    col_ = 0;
+  }
+  return true;
+}
+
+table_slice_ptr columnar_table_slice_builder::finish() {
+  // Sanity check.
+  if (col_ != 0)
+    return nullptr;
+  table_slice_header header{layout(), rows_, 0};
+  auto result = new columnar_table_slice{std::move(header)};
+  result->columns_ = std::move(columns_);
+  result->pool_ = pool_;
+  // Continue with the buffers of a destroyed slice if one is available, which
+  // makes building slices in a steady state free of allocations.
+  columns_ = pool_->acquire();
+  if (columns_.empty()) {
+    columns_.resize(columns());
+    reset_columns();
+    // Slices from the same source tend to have similar sizes, so we size the
+    // buffers of the next slice after this one. This way, each buffer usually
+    // needs a single allocation per slice.
+    for (size_t i = 0; i < columns_.size(); ++i) {
+      auto f = detail::overload(
+        [&](columnar_table_slice::string_array& xs) {
+          auto& prev = caf::get<columnar_table_slice::string_array>(
+            result->columns_[i].values);
+          xs.bytes.reserve(prev.bytes.size());
+        },
+        [&](columnar_table_slice::encoded_array& xs) {
+          auto& prev = caf::get<columnar_table_slice::encoded_array>(
+            result->columns_[i].values);
+          xs.bytes.reserve(prev.bytes.size());
+        },
+        [&](auto&) {
+          // nop
+        });
+      caf::visit(f, columns_[i].values);
+    }
+  }
+  reserve(rows_);
+  rows_ = 0;
+  return table_slice_ptr{result, false};
+}
+
+size_t columnar_table_slice_builder::rows() const noexcept {
+  return rows_;
+}
+
+void columnar_table_slice_builder::reserve(size_t num_rows) {
+  auto f = detail::overload(
+    [&](columnar_table_slice::string_array& xs) {
+      xs.offsets.reserve(num_rows);
+    },
+    [&](columnar_table_slice::encoded_array& xs) {
+      xs.offsets.reserve(num_rows);
+    },
+    [&](auto& xs) { xs.reserve(num_rows); });
+  for (auto& column : columns_)
+    caf::visit(f, column.values);
+}
+
+caf::atom_value
+columnar_table_slice_builder::implementation_id() const noexcept {
+  return get_implementation_id();
+}
+
+void columnar_table_slice_builder::reset_columns() {
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    columns_[i].valid = {};
+    columns_[i].values
+      = columnar_table_slice::make_array(layout().fields[i].type);
+  }
+}
+
+} // namespace vast
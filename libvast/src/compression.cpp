@@ -15,6 +15,8 @@
 #define LZ4_FORCE_INLINE
 #include "lz4/lib/lz4.c"
 
+#include <cstring>
+
 #include "vast/compression.hpp"
 #include "vast/die.hpp"
 
@@ -67,4 +69,58 @@ bool uncompress(const char* in, size_t in_size, char* out) {
 } // namespace snappy
 #endif // VAST_HAVE_SNAPPY
 
+size_t compress_bound(compression method, size_t size) {
+  switch (method) {
+    case compression::null:
+      return size;
+    case compression::lz4:
+      return lz4::compress_bound(size);
+#ifdef VAST_HAVE_SNAPPY
+    case compression::snappy:
+      return snappy::compress_bound(size);
+#endif // VAST_HAVE_SNAPPY
+  }
+  die("unhandled compression method");
+}
+
+size_t compress(compression method, const char* in, size_t in_size, char* out,
+                size_t out_size) {
+  switch (method) {
+    case compression::null:
+      if (out_size < in_size)
+        return 0;
+      std::memcpy(out, in, in_size);
+      return in_size;
+    case compression::lz4:
+      return lz4::compress(in, in_size, out, out_size);
+#ifdef VAST_HAVE_SNAPPY
+    case compression::snappy:
+      if (out_size < snappy::compress_bound(in_size))
+        return 0;
+      return snappy::compress(in, in_size, out);
+#endif // VAST_HAVE_SNAPPY
+  }
+  die("unhandled compression method");
+}
+
+bool uncompress(compression method, const char* in, size_t in_size, char* out,
+                size_t out_size) {
+  switch (method) {
+    case compression::null:
+      if (in_size != out_size)
+        return false;
+      std::memcpy(out, in, in_size);
+      return true;
+    case compression::lz4:
+      return lz4::uncompress(in, in_size, out, out_size) == out_size;
+#ifdef VAST_HAVE_SNAPPY
+    case compression::snappy:
+      if (snappy::uncompress_bound(in, in_size) != out_size)
+        return false;
+      return snappy::uncompress(in, in_size, out);
+#endif // VAST_HAVE_SNAPPY
+  }
+  die("unhandled compression method");
+}
+
 } // namespace vast
@@ -17,6 +17,7 @@
 #include <caf/serializer.hpp>
 
 #include "vast/default_table_slice_builder.hpp"
+#include "vast/detail/compact_encoding.hpp"
 #include "vast/value_index.hpp"
 
 namespace vast {
@@ -26,11 +27,20 @@ default_table_slice* default_table_slice::copy() const {
 }
 
 caf::error default_table_slice::serialize(caf::serializer& sink) const {
-  return sink(xs_);
+  std::vector<char> buf;
+  detail::compact_encode(buf, *this);
+  return sink(buf);
 }
 
 caf::error default_table_slice::deserialize(caf::deserializer& source) {
-  return source(xs_);
+  std::vector<char> buf;
+  if (auto err = source(buf))
+    return err;
+  xs_.assign(rows(), data{vector(columns())});
+  auto cell = [&](size_t row, size_t col) -> data& {
+    return caf::get<vector>(xs_[row])[col];
+  };
+  return detail::compact_decode(buf, layout(), rows(), cell);
 }
 
 void default_table_slice::append_column_to_index(size_type col,
@@ -72,4 +82,15 @@ default_table_slice::default_table_slice(table_slice_header header)
   // nop
 }
 
+default_table_slice::~default_table_slice() {
+  if (pool_ == nullptr)
+    return;
+  // Drop the cells but keep the row vectors for the next slice.
+  for (auto& row : xs_)
+    if (auto xs = caf::get_if<vector>(&row))
+      for (auto& x : *xs)
+        x = caf::none;
+  pool_->release(std::move(xs_));
+}
+
 } // namespace vast
@@ -26,7 +26,9 @@ caf::atom_value default_table_slice_builder::get_implementation_id() noexcept {
 default_table_slice_builder::default_table_slice_builder(record_type layout)
   : super{std::move(layout)},
     row_(super::layout().fields.size()),
-    col_{0} {
+    col_{0},
+    pool_{caf::make_counted<default_table_slice::pool_type>(
+      max_recycled_slices)} {
   VAST_ASSERT(!row_.empty());
 }
 
@@ -41,8 +43,17 @@ bool default_table_slice_builder::append(data x) {
     return false;
   row_[col_++] = std::move(x);
   if (col_ == layout().fields.size()) {
-    slice_->xs_.push_back(std::move(row_));
-    row_ = vector(slice_->columns());
+    auto& xs = slice_->xs_;
+    if (rows_ < xs.size()) {
+      // Trade the complete row for a recycled one with nil cells.
+      auto& recycled = caf::get<vector>(xs[rows_]);
+      VAST_ASSERT(recycled.size() == row_.size());
+      recycled.swap(row_);
+    } else {
+      xs.push_back(std::move(row_));
+      row_ = vector(slice_->columns());
+    }
+    ++rows_;
     col_ = 0;
   }
   return true;
@@ -55,15 +66,22 @@ bool default_table_slice_builder::add(data_view x) {
 table_slice_ptr default_table_slice_builder::finish() {
   // If we have an incomplete row, we take it as-is and keep the remaining null
   // values. Better to have incomplete than no data.
-  if (col_ != 0)
-    slice_->xs_.push_back(std::move(row_));
+  auto& xs = slice_->xs_;
+  xs.resize(rows_);
+  if (col_ != 0) {
+    xs.push_back(std::move(row_));
+    row_ = vector(slice_->columns());
+    col_ = 0;
+  }
   // Populate slice.
-  slice_->header_.rows = slice_->xs_.size();
+  slice_->header_.rows = xs.size();
+  slice_->pool_ = pool_;
+  rows_ = 0;
   return table_slice_ptr{slice_.release(), false};
 }
 
 size_t default_table_slice_builder::rows() const noexcept {
-  return slice_ == nullptr ? 0u : slice_->xs_.size();
+  return slice_ == nullptr ? 0u : rows_;
 }
 
 void default_table_slice_builder::reserve(size_t num_rows) {
@@ -81,8 +99,8 @@ void default_table_slice_builder::lazy_init() {
     table_slice_header header;
     header.layout = layout();
     slice_.reset(new default_table_slice{std::move(header)});
-    row_ = vector(slice_->columns());
-    col_ = 0;
+    slice_->xs_ = pool_->acquire();
+    rows_ = 0;
   }
 }
 
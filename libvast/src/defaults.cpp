@@ -57,14 +57,22 @@ caf::atom_value table_slice_type(caf::actor_system& sys,
 
 namespace system {
 
-caf::atom_value table_slice_type = caf::atom("default");
+caf::atom_value table_slice_type = caf::atom("columnar");
 size_t table_slice_size = 100;
+size_t table_slice_max_size = 64_Ki;
+std::chrono::milliseconds table_slice_deadline = std::chrono::seconds{1};
 size_t max_partition_size = 1_Mi;
 size_t max_in_mem_partitions = 10;
 size_t taste_partitions = 5;
 size_t num_query_supervisors = 10;
 size_t segments = 10;
 size_t max_segment_size = 128;
+caf::atom_value segment_compression = caf::atom("null");
+bool columnar_segments = false;
+bool dictionary_encoding = false;
+size_t max_pending_segments = 2;
+size_t extract_workers = 4;
+size_t max_extract_bytes = 512_Mi;
 size_t initially_requested_ids = 128;
 std::chrono::milliseconds telemetry_rate = std::chrono::milliseconds{1000};
 
@@ -0,0 +1,134 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/detail/block_kernels.hpp"
+
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VAST_BLOCK_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace vast::detail {
+
+namespace {
+
+struct and_op {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x & y;
+  }
+};
+
+struct or_op {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x | y;
+  }
+};
+
+struct xor_op {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x ^ y;
+  }
+};
+
+struct and_not_op {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x & ~y;
+  }
+};
+
+template <class Op>
+void scalar(const uint64_t* xs, const uint64_t* ys, uint64_t* out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = Op::apply(xs[i], ys[i]);
+}
+
+#ifdef VAST_BLOCK_KERNELS_X86
+
+// The vector kernels select the intrinsic inline rather than through a helper
+// function, because helpers would not inherit the target of the kernel. Note
+// that the ANDNOT intrinsics negate their first argument.
+
+template <class Op>
+__attribute__((target("sse2")))
+void sse2(const uint64_t* xs, const uint64_t* ys, uint64_t* out, size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xs + i));
+    auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i));
+    __m128i r;
+    if constexpr (std::is_same_v<Op, and_op>)
+      r = _mm_and_si128(x, y);
+    else if constexpr (std::is_same_v<Op, or_op>)
+      r = _mm_or_si128(x, y);
+    else if constexpr (std::is_same_v<Op, xor_op>)
+      r = _mm_xor_si128(x, y);
+    else
+      r = _mm_andnot_si128(y, x);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+  }
+  scalar<Op>(xs + i, ys + i, out + i, n - i);
+}
+
+template <class Op>
+__attribute__((target("avx2")))
+void avx2(const uint64_t* xs, const uint64_t* ys, uint64_t* out, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+    auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i));
+    __m256i r;
+    if constexpr (std::is_same_v<Op, and_op>)
+      r = _mm256_and_si256(x, y);
+    else if constexpr (std::is_same_v<Op, or_op>)
+      r = _mm256_or_si256(x, y);
+    else if constexpr (std::is_same_v<Op, xor_op>)
+      r = _mm256_xor_si256(x, y);
+    else
+      r = _mm256_andnot_si256(y, x);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+  }
+  scalar<Op>(xs + i, ys + i, out + i, n - i);
+}
+
+#endif // VAST_BLOCK_KERNELS_X86
+
+block_kernels detect_kernels() {
+#ifdef VAST_BLOCK_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {avx2<and_op>, avx2<or_op>, avx2<xor_op>, avx2<and_not_op>,
+            "avx2"};
+  // Every x86-64 CPU supports SSE2.
+  return {sse2<and_op>, sse2<or_op>, sse2<xor_op>, sse2<and_not_op>, "sse2"};
+#else
+  return scalar_block_kernels();
+#endif
+}
+
+} // namespace <anonymous>
+
+const block_kernels& scalar_block_kernels() {
+  static const block_kernels result{scalar<and_op>, scalar<or_op>,
+                                    scalar<xor_op>, scalar<and_not_op>,
+                                    "scalar"};
+  return result;
+}
+
+const block_kernels& simd_block_kernels() {
+  static const auto result = detect_kernels();
+  return result;
+}
+
+} // namespace vast::detail
@@ -0,0 +1,484 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/detail/compact_encoding.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include <caf/binary_deserializer.hpp>
+#include <caf/binary_serializer.hpp>
+
+#include "vast/address.hpp"
+#include "vast/data.hpp"
+#include "vast/error.hpp"
+#include "vast/port.hpp"
+#include "vast/subnet.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/type.hpp"
+#include "vast/view.hpp"
+
+#include "vast/detail/assert.hpp"
+#include "vast/detail/varbyte.hpp"
+#include "vast/detail/zigzag.hpp"
+
+namespace vast::detail {
+
+namespace {
+
+// The flags at the beginning of each column.
+enum column_flags : uint8_t {
+  has_nils = 0x01, // A validity bitmap follows the flags.
+  generic = 0x02,  // The cells use the generic encoding.
+};
+
+// The typed encodings of a column.
+enum class kind {
+  boolean,
+  integer,
+  count,
+  real,
+  timespan,
+  timestamp,
+  string,
+  address,
+  subnet,
+  port,
+  generic,
+};
+
+kind kind_of(const type& t) {
+  if (holds_alternative<boolean_type>(t))
+    return kind::boolean;
+  if (holds_alternative<integer_type>(t))
+    return kind::integer;
+  if (holds_alternative<count_type>(t))
+    return kind::count;
+  if (holds_alternative<real_type>(t))
+    return kind::real;
+  if (holds_alternative<timespan_type>(t))
+    return kind::timespan;
+  if (holds_alternative<timestamp_type>(t))
+    return kind::timestamp;
+  if (holds_alternative<string_type>(t))
+    return kind::string;
+  if (holds_alternative<address_type>(t))
+    return kind::address;
+  if (holds_alternative<subnet_type>(t))
+    return kind::subnet;
+  if (holds_alternative<port_type>(t))
+    return kind::port;
+  return kind::generic;
+}
+
+// Checks whether a non-nil cell has the representation of a typed encoding.
+bool matches(kind k, const data_view& x) {
+  switch (k) {
+    case kind::boolean:
+      return caf::holds_alternative<view<boolean>>(x);
+    case kind::integer:
+      return caf::holds_alternative<view<integer>>(x);
+    case kind::count:
+      return caf::holds_alternative<view<count>>(x);
+    case kind::real:
+      return caf::holds_alternative<view<real>>(x);
+    case kind::timespan:
+      return caf::holds_alternative<view<timespan>>(x);
+    case kind::timestamp:
+      return caf::holds_alternative<view<timestamp>>(x);
+    case kind::string:
+      return caf::holds_alternative<view<std::string>>(x);
+    case kind::address:
+      return caf::holds_alternative<view<address>>(x);
+    case kind::subnet:
+      return caf::holds_alternative<view<subnet>>(x);
+    case kind::port:
+      return caf::holds_alternative<view<port>>(x);
+    case kind::generic:
+      return true;
+  }
+  return false;
+}
+
+// -- encoding -----------------------------------------------------------------
+
+void put_byte(std::vector<char>& buf, uint8_t x) {
+  buf.push_back(static_cast<char>(x));
+}
+
+void put_raw(std::vector<char>& buf, const void* ptr, size_t size) {
+  auto first = static_cast<const char*>(ptr);
+  buf.insert(buf.end(), first, first + size);
+}
+
+void put_varbyte(std::vector<char>& buf, uint64_t x) {
+  char tmp[varbyte::max_size<uint64_t>()];
+  auto n = varbyte::encode(x, tmp);
+  buf.insert(buf.end(), tmp, tmp + n);
+}
+
+void put_bits(std::vector<char>& buf, const std::vector<bool>& bits) {
+  auto first = buf.size();
+  buf.resize(first + (bits.size() + 7) / 8, 0);
+  for (size_t i = 0; i < bits.size(); ++i)
+    if (bits[i])
+      buf[first + i / 8] |= static_cast<char>(1 << (i % 8));
+}
+
+void put_address(std::vector<char>& buf, const address& x) {
+  auto& bytes = x.data();
+  if (x.is_v4()) {
+    put_byte(buf, 4);
+    put_raw(buf, bytes.data() + 12, 4);
+  } else {
+    put_byte(buf, 16);
+    put_raw(buf, bytes.data(), 16);
+  }
+}
+
+void put_generic(std::vector<char>& buf, const data_view& x) {
+  std::vector<char> tmp;
+  caf::binary_serializer sink{nullptr, tmp};
+  auto y = materialize(x);
+  auto err = sink(y);
+  VAST_ASSERT(!err);
+  static_cast<void>(err);
+  put_varbyte(buf, tmp.size());
+  put_raw(buf, tmp.data(), tmp.size());
+}
+
+// Appends the values of all non-nil cells of a column.
+void put_values(std::vector<char>& buf, kind k,
+                const std::vector<data_view>& xs) {
+  switch (k) {
+    case kind::boolean: {
+      std::vector<bool> bits;
+      bits.reserve(xs.size());
+      for (auto& x : xs)
+        bits.push_back(caf::get<view<boolean>>(x));
+      put_bits(buf, bits);
+      break;
+    }
+    case kind::integer:
+      for (auto& x : xs)
+        put_varbyte(buf, zigzag::encode(caf::get<view<integer>>(x)));
+      break;
+    case kind::count:
+      for (auto& x : xs)
+        put_varbyte(buf, caf::get<view<count>>(x));
+      break;
+    case kind::real:
+      for (auto& x : xs) {
+        auto r = caf::get<view<real>>(x);
+        put_raw(buf, &r, sizeof(r));
+      }
+      break;
+    case kind::timespan:
+      for (auto& x : xs) {
+        auto ns = caf::get<view<timespan>>(x).count();
+        put_varbyte(buf, zigzag::encode(ns));
+      }
+      break;
+    case kind::timestamp: {
+      // Consecutive timestamps tend to be close, so their deltas are small.
+      uint64_t prev = 0;
+      for (auto& x : xs) {
+        auto ns = caf::get<view<timestamp>>(x).time_since_epoch().count();
+        auto delta = static_cast<int64_t>(static_cast<uint64_t>(ns) - prev);
+        put_varbyte(buf, zigzag::encode(delta));
+        prev = static_cast<uint64_t>(ns);
+      }
+      break;
+    }
+    case kind::string:
+      for (auto& x : xs)
+        put_varbyte(buf, caf::get<view<std::string>>(x).size());
+      for (auto& x : xs) {
+        auto str = caf::get<view<std::string>>(x);
+        put_raw(buf, str.data(), str.size());
+      }
+      break;
+    case kind::address:
+      for (auto& x : xs)
+        put_address(buf, caf::get<view<address>>(x));
+      break;
+    case kind::subnet:
+      for (auto& x : xs) {
+        auto& sn = caf::get<view<subnet>>(x);
+        put_address(buf, sn.network());
+        put_byte(buf, sn.length());
+      }
+      break;
+    case kind::port:
+      for (auto& x : xs) {
+        auto& p = caf::get<view<port>>(x);
+        put_varbyte(buf, p.number());
+        put_byte(buf, p.type());
+      }
+      break;
+    case kind::generic:
+      for (auto& x : xs)
+        put_generic(buf, x);
+      break;
+  }
+}
+
+// -- decoding -----------------------------------------------------------------
+
+// Reads from a range of bytes and fails instead of reading past its end.
+struct reader {
+  const char* ptr;
+  const char* end;
+
+  bool get_byte(uint8_t& x) {
+    if (ptr == end)
+      return false;
+    x = static_cast<uint8_t>(*ptr++);
+    return true;
+  }
+
+  bool get_raw(void* dst, size_t size) {
+    if (static_cast<size_t>(end - ptr) < size)
+      return false;
+    std::memcpy(dst, ptr, size);
+    ptr += size;
+    return true;
+  }
+
+  bool get_varbyte(uint64_t& x) {
+    // Make sure that the value terminates before the end of the input.
+    auto limit = std::min(static_cast<size_t>(end - ptr),
+                          varbyte::max_size<uint64_t>());
+    for (size_t i = 0; i < limit; ++i)
+      if ((static_cast<uint8_t>(ptr[i]) & 0x80) == 0) {
+        ptr += varbyte::decode(x, ptr);
+        return true;
+      }
+    return false;
+  }
+
+  bool get_bits(std::vector<bool>& bits, size_t n) {
+    auto size = (n + 7) / 8;
+    if (static_cast<size_t>(end - ptr) < size)
+      return false;
+    bits.resize(n);
+    for (size_t i = 0; i < n; ++i)
+      bits[i] = (static_cast<uint8_t>(ptr[i / 8]) >> (i % 8)) & 1;
+    ptr += size;
+    return true;
+  }
+
+  bool get_address(address& x) {
+    uint8_t size;
+    char bytes[16];
+    if (!get_byte(size) || (size != 4 && size != 16) || !get_raw(bytes, size))
+      return false;
+    x = size == 4 ? address::v4(bytes, address::network)
+                  : address::v6(bytes, address::network);
+    return true;
+  }
+
+  bool get_generic(data& x) {
+    uint64_t size;
+    if (!get_varbyte(size) || static_cast<uint64_t>(end - ptr) < size)
+      return false;
+    caf::binary_deserializer source{nullptr, ptr, static_cast<size_t>(size)};
+    if (source(x))
+      return false;
+    ptr += size;
+    return true;
+  }
+};
+
+caf::error truncated() {
+  return make_error(ec::format_error, "got truncated table slice cells");
+}
+
+// Reads the values of the non-nil cells of a column into *xs*.
+bool get_values(reader& r, kind k, std::vector<data*>& xs) {
+  switch (k) {
+    case kind::boolean: {
+      std::vector<bool> bits;
+      if (!r.get_bits(bits, xs.size()))
+        return false;
+      for (size_t i = 0; i < xs.size(); ++i)
+        *xs[i] = static_cast<bool>(bits[i]);
+      return true;
+    }
+    case kind::integer:
+      for (auto x : xs) {
+        uint64_t u;
+        if (!r.get_varbyte(u))
+          return false;
+        *x = integer{zigzag::decode(u)};
+      }
+      return true;
+    case kind::count:
+      for (auto x : xs) {
+        uint64_t u;
+        if (!r.get_varbyte(u))
+          return false;
+        *x = count{u};
+      }
+      return true;
+    case kind::real:
+      for (auto x : xs) {
+        real f;
+        if (!r.get_raw(&f, sizeof(f)))
+          return false;
+        *x = f;
+      }
+      return true;
+    case kind::timespan:
+      for (auto x : xs) {
+        uint64_t u;
+        if (!r.get_varbyte(u))
+          return false;
+        *x = timespan{zigzag::decode(u)};
+      }
+      return true;
+    case kind::timestamp: {
+      uint64_t prev = 0;
+      for (auto x : xs) {
+        uint64_t u;
+        if (!r.get_varbyte(u))
+          return false;
+        prev += static_cast<uint64_t>(zigzag::decode(u));
+        *x = timestamp{timespan{static_cast<int64_t>(prev)}};
+      }
+      return true;
+    }
+    case kind::string: {
+      std::vector<uint64_t> lengths(xs.size());
+      for (auto& n : lengths)
+        if (!r.get_varbyte(n))
+          return false;
+      for (size_t i = 0; i < xs.size(); ++i) {
+        if (static_cast<uint64_t>(r.end - r.ptr) < lengths[i])
+          return false;
+        *xs[i] = std::string{r.ptr, static_cast<size_t>(lengths[i])};
+        r.ptr += lengths[i];
+      }
+      return true;
+    }
+    case kind::address:
+      for (auto x : xs) {
+        address a;
+        if (!r.get_address(a))
+          return false;
+        *x = a;
+      }
+      return true;
+    case kind::subnet:
+      for (auto x : xs) {
+        address a;
+        uint8_t length;
+        if (!r.get_address(a) || !r.get_byte(length))
+          return false;
+        *x = subnet{a, length};
+      }
+      return true;
+    case kind::port:
+      for (auto x : xs) {
+        uint64_t number;
+        uint8_t type;
+        if (!r.get_varbyte(number) || !r.get_byte(type)
+            || number > std::numeric_limits<port::number_type>::max())
+          return false;
+        *x = port{static_cast<port::number_type>(number),
+                  static_cast<port::port_type>(type)};
+      }
+      return true;
+    case kind::generic:
+      for (auto x : xs)
+        if (!r.get_generic(*x))
+          return false;
+      return true;
+  }
+  return false;
+}
+
+} // namespace <anonymous>
+
+void compact_encode(std::vector<char>& buf, const table_slice& xs) {
+  std::vector<data_view> values;
+  std::vector<bool> valid;
+  values.reserve(xs.rows());
+  valid.reserve(xs.rows());
+  for (table_slice::size_type col = 0; col < xs.columns(); ++col) {
+    auto k = kind_of(xs.layout().fields[col].type);
+    values.clear();
+    valid.clear();
+    for (table_slice::size_type row = 0; row < xs.rows(); ++row) {
+      auto x = xs.at(row, col);
+      auto is_valid = !caf::holds_alternative<caf::none_t>(x);
+      valid.push_back(is_valid);
+      if (!is_valid)
+        continue;
+      if (!matches(k, x))
+        k = kind::generic;
+      values.push_back(x);
+    }
+    uint8_t flags = 0;
+    if (values.size() < xs.rows())
+      flags |= has_nils;
+    if (k == kind::generic)
+      flags |= generic;
+    put_byte(buf, flags);
+    if (flags & has_nils)
+      put_bits(buf, valid);
+    put_values(buf, k, values);
+  }
+}
+
+caf::error compact_decode(span<const char> bytes, const record_type& layout,
+                          size_t rows,
+                          const std::function<data&(size_t, size_t)>& cell) {
+  reader r{bytes.data(), bytes.data() + bytes.size()};
+  std::vector<bool> valid;
+  std::vector<data*> values;
+  values.reserve(rows);
+  for (size_t col = 0; col < layout.fields.size(); ++col) {
+    uint8_t flags;
+    if (!r.get_byte(flags))
+      return truncated();
+    if ((flags & ~(has_nils | generic)) != 0)
+      return make_error(ec::format_error, "got invalid column flags", flags);
+    if (flags & has_nils) {
+      if (!r.get_bits(valid, rows))
+        return truncated();
+    } else {
+      valid.assign(rows, true);
+    }
+    values.clear();
+    for (size_t row = 0; row < rows; ++row) {
+      auto& x = cell(row, col);
+      if (valid[row])
+        values.push_back(&x);
+      else
+        x = caf::none;
+    }
+    auto k = flags & generic ? kind::generic
+                             : kind_of(layout.fields[col].type);
+    if (!get_values(r, k, values))
+      return truncated();
+  }
+  if (r.ptr != r.end)
+    return make_error(ec::format_error, "got trailing table slice cells");
+  return caf::none;
+}
+
+} // namespace vast::detail
@@ -13,6 +13,9 @@
 
 #include "vast/ewah_bitmap.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace vast {
 
 ewah_bitmap::ewah_bitmap(size_type n, bool bit) {
@@ -148,6 +151,39 @@ void ewah_bitmap::append_block(block_type value, size_type bits) {
   }
 }
 
+void ewah_bitmap::append_blocks(const block_type* first,
+                                const block_type* last) {
+  if (num_bits_ % word_type::width != 0) {
+    for (; first != last; ++first)
+      append_block(*first);
+    return;
+  }
+  if (first == last)
+    return;
+  if (blocks_.empty()) {
+    blocks_.push_back(0); // Always begin with an empty marker.
+    blocks_.push_back(*first++);
+    num_bits_ += word_type::width;
+  }
+  // Grow geometrically, because reserving the exact size would reallocate the
+  // blocks on every call when appending many short stretches.
+  auto required = blocks_.size() + (last - first);
+  if (required > blocks_.capacity())
+    blocks_.reserve(std::max(required, 2 * blocks_.capacity()));
+  for (; first != last; ++first) {
+    // Take a shortcut for the common case of a dirty block that fits into the
+    // current marker.
+    auto& marker = blocks_[last_marker_];
+    if (!word_type::all_or_none(blocks_.back())
+        && word_type::marker_num_dirty(marker) < word_type::marker_dirty_max)
+      ++marker;
+    else
+      integrate_last_block();
+    blocks_.push_back(*first);
+    num_bits_ += word_type::width;
+  }
+}
+
 void ewah_bitmap::flip() {
   if (blocks_.empty())
     return;
@@ -297,4 +333,169 @@ ewah_bitmap_range bit_range(const ewah_bitmap& bm) {
   return ewah_bitmap_range{bm};
 }
 
+namespace {
+
+// Walks over the blocks of an EWAH bitmap as a sequence of clean runs and
+// stretches of dirty blocks. Past its last block, the cursor yields an
+// infinite run of zeros.
+class ewah_cursor {
+public:
+  using block_type = ewah_bitmap::block_type;
+  using word_type = ewah_bitmap::word_type;
+
+  static constexpr auto infinite = std::numeric_limits<size_t>::max();
+
+  explicit ewah_cursor(const ewah_bitmap& bm)
+    : next_{bm.blocks().data()},
+      end_{bm.blocks().data() + bm.blocks().size()} {
+    normalize();
+  }
+
+  /// @returns whether the cursor points to a clean run.
+  bool clean() const {
+    return clean_ > 0;
+  }
+
+  /// @returns the block of the current clean run.
+  block_type fill() const {
+    return type_ ? word_type::all : word_type::none;
+  }
+
+  /// @returns the current dirty blocks.
+  const block_type* dirty() const {
+    return next_;
+  }
+
+  /// @returns the number of remaining blocks in the current run or stretch.
+  size_t length() const {
+    return clean_ > 0 ? clean_ : dirty_;
+  }
+
+  /// Advances the cursor by *n* blocks within the current run or stretch.
+  void skip(size_t n) {
+    VAST_ASSERT(n <= length());
+    if (clean_ > 0) {
+      if (clean_ != infinite)
+        clean_ -= n;
+    } else {
+      next_ += n;
+      dirty_ -= n;
+    }
+    normalize();
+  }
+
+private:
+  void normalize() {
+    while (clean_ == 0 && dirty_ == 0) {
+      if (next_ == end_) {
+        type_ = false;
+        clean_ = infinite;
+      } else if (next_ + 1 == end_) {
+        // The last block is always dirty and not accounted for in a marker.
+        dirty_ = 1;
+      } else {
+        auto marker = *next_++;
+        type_ = word_type::marker_type(marker);
+        clean_ = word_type::marker_num_clean(marker);
+        dirty_ = std::min(size_t{word_type::marker_num_dirty(marker)},
+                          static_cast<size_t>(end_ - next_));
+      }
+    }
+  }
+
+  const block_type* next_;
+  const block_type* end_;
+  size_t clean_ = 0;
+  size_t dirty_ = 0;
+  bool type_ = false;
+};
+
+} // namespace <anonymous>
+
+ewah_bitmap binary_eval(const ewah_bitmap& lhs, const ewah_bitmap& rhs,
+                        detail::block_operation op,
+                        const detail::block_kernels& kernels) {
+  using word_type = ewah_bitmap::word_type;
+  using block_type = ewah_bitmap::block_type;
+  ewah_bitmap result;
+  auto size = std::max(lhs.size(), rhs.size());
+  if (size == 0)
+    return result;
+  auto num_blocks = (size + word_type::width - 1) / word_type::width;
+  auto partial = size % word_type::width;
+  auto kernel = kernels[op];
+  std::vector<block_type> buf;
+  size_t i = 0;
+  // Appends the next n blocks, the last of which may be partial.
+  auto append_run = [&](bool bit, size_t n) {
+    auto bits = n * word_type::width;
+    if (i + n == num_blocks && partial > 0)
+      bits -= word_type::width - partial;
+    result.append_bits(bit, bits);
+  };
+  auto append_dirty = [&](const block_type* xs, size_t n) {
+    if (i + n == num_blocks && partial > 0) {
+      result.append_blocks(xs, xs + n - 1);
+      result.append_block(xs[n - 1], partial);
+    } else {
+      result.append_blocks(xs, xs + n);
+    }
+  };
+  ewah_cursor x{lhs};
+  ewah_cursor y{rhs};
+  while (i < num_blocks) {
+    auto n = std::min({x.length(), y.length(), num_blocks - i});
+    if (x.clean() && y.clean()) {
+      append_run(detail::combine(op, x.fill(), y.fill()) != 0, n);
+    } else if (!x.clean() && !y.clean()) {
+      buf.resize(n);
+      kernel(x.dirty(), y.dirty(), buf.data(), n);
+      append_dirty(buf.data(), n);
+    } else {
+      // A run on one side either determines the result by itself or passes
+      // the dirty blocks of the other side through, possibly negated.
+      auto clean_lhs = x.clean();
+      auto fill = clean_lhs ? x.fill() : y.fill();
+      auto dirty = clean_lhs ? y.dirty() : x.dirty();
+      auto eval = [&](block_type z) {
+        return clean_lhs ? detail::combine(op, fill, z)
+                         : detail::combine(op, z, fill);
+      };
+      auto zeros = eval(word_type::none);
+      auto ones = eval(word_type::all);
+      if (zeros == ones) {
+        append_run(zeros != 0, n);
+      } else if (zeros == word_type::none) {
+        append_dirty(dirty, n);
+      } else {
+        buf.resize(n);
+        std::transform(dirty, dirty + n, buf.begin(),
+                       [](block_type z) { return ~z; });
+        append_dirty(buf.data(), n);
+      }
+    }
+    x.skip(n);
+    y.skip(n);
+    i += n;
+  }
+  VAST_ASSERT(result.size() == size);
+  return result;
+}
+
+ewah_bitmap binary_and(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::and_op);
+}
+
+ewah_bitmap binary_or(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::or_op);
+}
+
+ewah_bitmap binary_xor(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::xor_op);
+}
+
+ewah_bitmap binary_nand(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::and_not_op);
+}
+
 } // namespace vast
@@ -0,0 +1,394 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/packed_table_slice.hpp"
+
+#include <array>
+#include <cstring>
+
+#include <caf/deserializer.hpp>
+#include <caf/make_counted.hpp>
+#include <caf/serializer.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "vast/error.hpp"
+
+#include "vast/detail/assert.hpp"
+#include "vast/detail/narrow.hpp"
+#include "vast/detail/overload.hpp"
+
+namespace vast {
+
+namespace {
+
+// Identifies the alternative of an encoded cell.
+enum class tag : uint8_t {
+  none,
+  boolean,
+  integer,
+  count,
+  real,
+  timespan,
+  timestamp,
+  string,
+  pattern,
+  address,
+  subnet,
+  port,
+  vector,
+  set,
+  map,
+  code,
+};
+
+template <class T>
+T load_unaligned(const char* ptr) {
+  T result;
+  std::memcpy(&result, ptr, sizeof(T));
+  return result;
+}
+
+template <class T>
+void append(std::vector<char>& buf, T x) {
+  auto ptr = reinterpret_cast<const char*>(&x);
+  buf.insert(buf.end(), ptr, ptr + sizeof(T));
+}
+
+void append(std::vector<char>& buf, tag x) {
+  buf.push_back(static_cast<char>(x));
+}
+
+// Encodes a sequence of elements as count, offsets, and data.
+template <class Iterator, class F>
+void encode_elements(std::vector<char>& buf, uint32_t n, Iterator first,
+                     Iterator last, F f) {
+  append(buf, n);
+  auto offsets = buf.size();
+  buf.resize(buf.size() + (n + 1) * sizeof(uint32_t));
+  auto body = buf.size();
+  uint32_t i = 0;
+  auto put_offset = [&] {
+    auto x = detail::narrow_cast<uint32_t>(buf.size() - body);
+    std::memcpy(buf.data() + offsets + i++ * sizeof(uint32_t), &x, sizeof(x));
+  };
+  for (; first != last; ++first) {
+    put_offset();
+    f(*first);
+  }
+  put_offset();
+}
+
+// A view over an encoded vector or set.
+class packed_list_view : public container_view<data_view> {
+public:
+  explicit packed_list_view(const char* ptr)
+    : size_{load_unaligned<uint32_t>(ptr)},
+      offsets_{ptr + sizeof(uint32_t)},
+      body_{offsets_ + (size_ + 1) * sizeof(uint32_t)} {
+    // nop
+  }
+
+  value_type at(size_type i) const override {
+    VAST_ASSERT(i < size_);
+    auto first = load_unaligned<uint32_t>(offsets_ + i * sizeof(uint32_t));
+    auto last = load_unaligned<uint32_t>(offsets_ + (i + 1) * sizeof(uint32_t));
+    return packed_table_slice::decode(body_ + first, last - first);
+  }
+
+  size_type size() const noexcept override {
+    return size_;
+  }
+
+private:
+  uint32_t size_;
+  const char* offsets_;
+  const char* body_;
+};
+
+// A view over an encoded map, which stores keys and values alternatingly.
+class packed_map_view
+  : public container_view<std::pair<data_view, data_view>> {
+public:
+  explicit packed_map_view(const char* ptr) : elements_{ptr} {
+    // nop
+  }
+
+  value_type at(size_type i) const override {
+    return {elements_.at(2 * i), elements_.at(2 * i + 1)};
+  }
+
+  size_type size() const noexcept override {
+    return elements_.size() / 2;
+  }
+
+private:
+  packed_list_view elements_;
+};
+
+} // namespace <anonymous>
+
+data_view packed_table_slice::decode(const char* ptr, size_t size) {
+  VAST_ASSERT(size > 0);
+  auto x = static_cast<tag>(*ptr++);
+  --size;
+  switch (x) {
+    case tag::none:
+      return caf::none;
+    case tag::boolean:
+      return *ptr != 0;
+    case tag::integer:
+      return load_unaligned<integer>(ptr);
+    case tag::count:
+      return load_unaligned<count>(ptr);
+    case tag::real:
+      return load_unaligned<real>(ptr);
+    case tag::timespan:
+      return timespan{load_unaligned<timespan::rep>(ptr)};
+    case tag::timestamp:
+      return timestamp{timespan{load_unaligned<timespan::rep>(ptr)}};
+    case tag::string:
+      return std::string_view{ptr, size};
+    case tag::pattern:
+      return pattern_view{std::string_view{ptr, size}};
+    case tag::address: {
+      auto bytes = load_unaligned<std::array<uint8_t, 16>>(ptr);
+      return address::v6(bytes.data(), address::network);
+    }
+    case tag::subnet: {
+      auto bytes = load_unaligned<std::array<uint8_t, 16>>(ptr);
+      auto length = load_unaligned<uint8_t>(ptr + 16);
+      return subnet{address::v6(bytes.data(), address::network), length};
+    }
+    case tag::port: {
+      auto number = load_unaligned<port::number_type>(ptr);
+      auto type = load_unaligned<uint8_t>(ptr + sizeof(port::number_type));
+      return port{number, static_cast<port::port_type>(type)};
+    }
+    case tag::vector:
+      return vector_view_ptr{caf::make_counted<packed_list_view>(ptr)};
+    case tag::set:
+      return set_view_ptr{caf::make_counted<packed_list_view>(ptr)};
+    case tag::map:
+      return map_view_ptr{caf::make_counted<packed_map_view>(ptr)};
+    case tag::code:
+      // Codes only occur at the top level of a column and never reach here.
+      break;
+  }
+  VAST_ASSERT(!"invalid cell tag");
+  return caf::none;
+}
+
+table_slice_ptr packed_table_slice::make(table_slice_header header) {
+  return table_slice_ptr{new packed_table_slice{std::move(header)}, false};
+}
+
+void packed_table_slice::encode(std::vector<char>& buf, data_view x) {
+  auto f = detail::overload(
+    [&](caf::none_t) { append(buf, tag::none); },
+    [&](view<boolean> y) {
+      append(buf, tag::boolean);
+      buf.push_back(y ? 1 : 0);
+    },
+    [&](view<integer> y) {
+      append(buf, tag::integer);
+      append(buf, y);
+    },
+    [&](view<count> y) {
+      append(buf, tag::count);
+      append(buf, y);
+    },
+    [&](view<real> y) {
+      append(buf, tag::real);
+      append(buf, y);
+    },
+    [&](view<timespan> y) {
+      append(buf, tag::timespan);
+      append(buf, y.count());
+    },
+    [&](view<timestamp> y) {
+      append(buf, tag::timestamp);
+      append(buf, y.time_since_epoch().count());
+    },
+    [&](view<std::string> y) {
+      append(buf, tag::string);
+      buf.insert(buf.end(), y.begin(), y.end());
+    },
+    [&](view<pattern> y) {
+      append(buf, tag::pattern);
+      auto str = y.string();
+      buf.insert(buf.end(), str.begin(), str.end());
+    },
+    [&](view<address> y) {
+      append(buf, tag::address);
+      append(buf, y.data());
+    },
+    [&](view<subnet> y) {
+      append(buf, tag::subnet);
+      append(buf, y.network().data());
+      append(buf, y.length());
+    },
+    [&](view<port> y) {
+      append(buf, tag::port);
+      append(buf, y.number());
+      append(buf, static_cast<uint8_t>(y.type()));
+    },
+    [&](view<vector> ys) {
+      append(buf, tag::vector);
+      auto n = detail::narrow_cast<uint32_t>(ys->size());
+      encode_elements(buf, n, ys->begin(), ys->end(),
+                      [&](const data_view& y) { encode(buf, y); });
+    },
+    [&](view<set> ys) {
+      append(buf, tag::set);
+      auto n = detail::narrow_cast<uint32_t>(ys->size());
+      encode_elements(buf, n, ys->begin(), ys->end(),
+                      [&](const data_view& y) { encode(buf, y); });
+    },
+    [&](view<map> ys) {
+      append(buf, tag::map);
+      // Keys and values are stored as a flat sequence of 2n elements, so that
+      // the offsets table has one entry per key and per value.
+      std::vector<data_view> flat;
+      flat.reserve(ys->size() * 2);
+      for (auto [key, value] : *ys) {
+        flat.push_back(key);
+        flat.push_back(value);
+      }
+      auto n = detail::narrow_cast<uint32_t>(flat.size());
+      encode_elements(buf, n, flat.begin(), flat.end(),
+                      [&](const data_view& y) { encode(buf, y); });
+    });
+  caf::visit(f, x);
+}
+
+void packed_table_slice::encode_code(std::vector<char>& buf, uint16_t code) {
+  append(buf, tag::code);
+  append(buf, code);
+}
+
+void packed_table_slice::encode_dictionary(
+  std::vector<char>& buf, const std::vector<std::string_view>& entries) {
+  auto n = detail::narrow_cast<uint32_t>(entries.size());
+  encode_elements(buf, n, entries.begin(), entries.end(),
+                  [&](std::string_view x) {
+                    buf.insert(buf.end(), x.begin(), x.end());
+                  });
+}
+
+packed_table_slice* packed_table_slice::copy() const {
+  // The chunk is immutable, so the copy can share it.
+  return new packed_table_slice(*this);
+}
+
+caf::error packed_table_slice::serialize(caf::serializer& sink) const {
+  return sink(chunk_);
+}
+
+caf::error packed_table_slice::deserialize(caf::deserializer& source) {
+  if (auto err = source(chunk_))
+    return err;
+  return validate();
+}
+
+caf::error packed_table_slice::load(chunk_ptr chunk) {
+  VAST_ASSERT(chunk != nullptr);
+  // Read the size prefix written by the chunk serialization and then point
+  // directly into the remaining bytes.
+  auto data = const_cast<char*>(chunk->data()); // CAF won't touch it.
+  caf::charbuf buf{data, chunk->size()};
+  caf::stream_deserializer<caf::charbuf&> source{buf};
+  uint32_t n;
+  if (auto err = source(n))
+    return err;
+  auto prefix_size = chunk->size() - static_cast<size_t>(buf.in_avail());
+  if (n == 0 || prefix_size + n > chunk->size())
+    return make_error(ec::format_error, "invalid packed table slice size");
+  chunk_ = chunk->slice(prefix_size, n);
+  return validate();
+}
+
+data_view packed_table_slice::at(size_type row, size_type col) const {
+  VAST_ASSERT(row < rows());
+  VAST_ASSERT(col < columns());
+  auto base = chunk_->data();
+  auto column = base + load_unaligned<uint32_t>(base + col * sizeof(uint32_t));
+  auto first = load_unaligned<uint32_t>(column + row * sizeof(uint32_t));
+  auto last = load_unaligned<uint32_t>(column + (row + 1) * sizeof(uint32_t));
+  auto cells = column + (rows() + 1) * sizeof(uint32_t);
+  if (static_cast<tag>(cells[first]) == tag::code) {
+    // The dictionary starts right after the last cell.
+    auto end = load_unaligned<uint32_t>(column + rows() * sizeof(uint32_t));
+    auto code = load_unaligned<uint16_t>(cells + first + 1);
+    auto dictionary = cells + end;
+    auto n = load_unaligned<uint32_t>(dictionary);
+    VAST_ASSERT(code < n);
+    auto offsets = dictionary + sizeof(uint32_t);
+    auto body = offsets + (n + 1) * sizeof(uint32_t);
+    auto x = load_unaligned<uint32_t>(offsets + code * sizeof(uint32_t));
+    auto y = load_unaligned<uint32_t>(offsets + (code + 1) * sizeof(uint32_t));
+    return std::string_view{body + x, y - x};
+  }
+  return decode(cells + first, last - first);
+}
+
+caf::atom_value packed_table_slice::implementation_id() const noexcept {
+  return class_id;
+}
+
+table_slice_ptr
+packed_table_slice::project(const std::vector<size_type>& columns) const {
+  VAST_ASSERT(!columns.empty() && columns.back() < this->columns());
+  auto base = chunk_->data();
+  auto column_offset = [&](size_type col) -> size_t {
+    if (col == this->columns())
+      return chunk_->size();
+    return load_unaligned<uint32_t>(base + col * sizeof(uint32_t));
+  };
+  // Lay out the new column offsets followed by the selected column ranges.
+  std::vector<char> buf(columns.size() * sizeof(uint32_t));
+  for (size_t i = 0; i < columns.size(); ++i) {
+    auto first = column_offset(columns[i]);
+    auto last = column_offset(columns[i] + 1);
+    auto x = detail::narrow_cast<uint32_t>(buf.size());
+    std::memcpy(buf.data() + i * sizeof(uint32_t), &x, sizeof(x));
+    buf.insert(buf.end(), base + first, base + last);
+  }
+  auto header = header_;
+  header.layout.fields.clear();
+  for (auto col : columns)
+    header.layout.fields.push_back(layout().fields[col]);
+  auto result = new packed_table_slice{std::move(header)};
+  result->chunk_ = chunk::make(std::move(buf));
+  return table_slice_ptr{result, false};
+}
+
+packed_table_slice::packed_table_slice(table_slice_header header)
+  : table_slice{std::move(header)} {
+  // nop
+}
+
+caf::error packed_table_slice::validate() const {
+  if (chunk_ == nullptr || chunk_->size() < columns() * sizeof(uint32_t))
+    return make_error(ec::format_error, "truncated packed table slice");
+  auto offsets_size = (rows() + 1) * sizeof(uint32_t);
+  for (size_type col = 0; col < columns(); ++col) {
+    auto offset = load_unaligned<uint32_t>(chunk_->data()
+                                           + col * sizeof(uint32_t));
+    if (offset + offsets_size > chunk_->size())
+      return make_error(ec::format_error, "truncated packed table slice");
+  }
+  return caf::none;
+}
+
+} // namespace vast
@@ -0,0 +1,180 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/packed_table_slice_builder.hpp"
+
+#include <cstring>
+
+#include <caf/make_counted.hpp>
+
+#include "vast/chunk.hpp"
+#include "vast/type.hpp"
+
+#include "vast/detail/narrow.hpp"
+
+namespace vast {
+
+namespace {
+
+// The maximum number of distinct strings per column dictionary, bounded by the
+// 16-bit codes. Columns with more distinct values are not worth encoding.
+constexpr size_t max_dictionary_size = 1 << 16;
+
+} // namespace <anonymous>
+
+caf::atom_value packed_table_slice_builder::get_implementation_id() noexcept {
+  return packed_table_slice::class_id;
+}
+
+packed_table_slice_builder::packed_table_slice_builder(
+  record_type layout, bool dictionary_encoding)
+  : super{std::move(layout)},
+    dictionary_encoding_{dictionary_encoding},
+    col_{0},
+    rows_{0},
+    columns_(columns()) {
+  VAST_ASSERT(!columns_.empty());
+  reset_columns();
+}
+
+packed_table_slice_builder::~packed_table_slice_builder() {
+  // nop
+}
+
+table_slice_builder_ptr packed_table_slice_builder::make(record_type layout) {
+  return caf::make_counted<packed_table_slice_builder>(std::move(layout));
+}
+
+bool packed_table_slice_builder::add(data_view x) {
+  if (!type_check(layout().fields[col_].type, x))
+    return false;
+  auto& column = columns_[col_];
+  column.offsets.push_back(detail::narrow_cast<uint32_t>(column.cells.size()));
+  packed_table_slice::encode(column.cells, x);
+  if (column.dictionary)
+    add_code(column, x);
+  if (++col_ == columns()) {
+    ++rows_;
+    col_ = 0;
+  }
+  return true;
+}
+
+table_slice_ptr packed_table_slice_builder::finish() {
+  // Sanity check.
+  if (col_ != 0)
+    return nullptr;
+  // Terminate the cell offsets and switch to the dictionary encoding where it
+  // saves space. The dictionary follows the last cell.
+  for (auto& column : columns_) {
+    column.offsets.push_back(
+      detail::narrow_cast<uint32_t>(column.cells.size()));
+    if (!column.dictionary)
+      continue;
+    column.coded_offsets.push_back(
+      detail::narrow_cast<uint32_t>(column.coded_cells.size()));
+    packed_table_slice::encode_dictionary(column.coded_cells, column.entries);
+    if (column.coded_cells.size() < column.cells.size()) {
+      column.offsets.swap(column.coded_offsets);
+      column.cells.swap(column.coded_cells);
+    }
+  }
+  // Compute the layout of the chunk.
+  auto column_offsets_size = columns() * sizeof(uint32_t);
+  auto cell_offsets_size = (rows_ + 1) * sizeof(uint32_t);
+  auto size = column_offsets_size;
+  for (auto& column : columns_)
+    size += cell_offsets_size + column.cells.size();
+  std::vector<char> buf(size);
+  auto ptr = buf.data();
+  auto column_offset = column_offsets_size;
+  for (auto& column : columns_) {
+    auto x = detail::narrow_cast<uint32_t>(column_offset);
+    std::memcpy(ptr, &x, sizeof(x));
+    ptr += sizeof(x);
+    auto dst = buf.data() + column_offset;
+    std::memcpy(dst, column.offsets.data(), cell_offsets_size);
+    std::memcpy(dst + cell_offsets_size, column.cells.data(),
+                column.cells.size());
+    column_offset += cell_offsets_size + column.cells.size();
+  }
+  reset_columns();
+  // Construct the slice and reset the builder state.
+  table_slice_header header{layout(), rows_, 0};
+  auto result = new packed_table_slice{std::move(header)};
+  result->chunk_ = chunk::make(std::move(buf));
+  rows_ = 0;
+  return table_slice_ptr{result, false};
+}
+
+size_t packed_table_slice_builder::rows() const noexcept {
+  return rows_;
+}
+
+void packed_table_slice_builder::reserve(size_t num_rows) {
+  for (auto& column : columns_) {
+    column.offsets.reserve(num_rows + 1);
+    if (column.dictionary)
+      column.coded_offsets.reserve(num_rows + 1);
+  }
+}
+
+caf::atom_value packed_table_slice_builder::implementation_id() const noexcept {
+  return get_implementation_id();
+}
+
+void packed_table_slice_builder::add_code(column_buffer& column,
+                                          data_view x) {
+  auto str = caf::get_if<view<std::string>>(&x);
+  auto i = str ? column.codes.find(*str) : column.codes.end();
+  if (str && i == column.codes.end()) {
+    if (column.entries.size() == max_dictionary_size) {
+      // Too many distinct values: give up on the dictionary.
+      column.dictionary = false;
+      column.coded_offsets = {};
+      column.coded_cells = {};
+      column.strings = {};
+      column.codes = {};
+      column.entries = {};
+      return;
+    }
+    auto code = detail::narrow_cast<uint16_t>(column.entries.size());
+    auto& entry = column.strings.emplace_back(*str);
+    column.entries.emplace_back(entry);
+    i = column.codes.emplace(entry, code).first;
+  }
+  auto offset = detail::narrow_cast<uint32_t>(column.coded_cells.size());
+  column.coded_offsets.push_back(offset);
+  if (str)
+    packed_table_slice::encode_code(column.coded_cells, i->second);
+  else
+    packed_table_slice::encode(column.coded_cells, x);
+}
+
+void packed_table_slice_builder::reset_columns() {
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    auto& column = columns_[i];
+    column.offsets.clear();
+    column.cells.clear();
+    column.dictionary = dictionary_encoding_
+                        && holds_alternative<string_type>(
+                             layout().fields[i].type);
+    column.coded_offsets.clear();
+    column.coded_cells.clear();
+    column.strings.clear();
+    column.codes.clear();
+    column.entries.clear();
+  }
+}
+
+} // namespace vast
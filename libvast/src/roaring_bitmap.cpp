@@ -0,0 +1,773 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <iterator>
+
+#include "vast/roaring_bitmap.hpp"
+
+#include "vast/detail/overload.hpp"
+
+namespace vast {
+
+namespace {
+
+using size_type = roaring_bitmap::size_type;
+using block_type = roaring_bitmap::block_type;
+using word_type = roaring_bitmap::word_type;
+using array_container = roaring_bitmap::array_container;
+using bitset_container = roaring_bitmap::bitset_container;
+using run_container = roaring_bitmap::run_container;
+using full_container = roaring_bitmap::full_container;
+using container = roaring_bitmap::container;
+using chunk = roaring_bitmap::chunk;
+
+constexpr auto chunk_size = roaring_bitmap::chunk_size;
+constexpr auto chunk_blocks = roaring_bitmap::chunk_blocks;
+constexpr auto max_array_size = roaring_bitmap::max_array_size;
+constexpr auto max_runs = roaring_bitmap::max_runs;
+constexpr auto width = word_type::width;
+
+// -- bitset utilities ---------------------------------------------------------
+
+// Sets the bits in [first, last) of a chunk.
+void set_bits(std::vector<block_type>& blocks, size_t first, size_t last) {
+  VAST_ASSERT(first < last && last <= chunk_size);
+  auto i = first / width;
+  auto j = (last - 1) / width;
+  auto lo = word_type::all << (first % width);
+  auto hi = word_type::all >> (width - 1 - (last - 1) % width);
+  if (i == j) {
+    blocks[i] |= lo & hi;
+    return;
+  }
+  blocks[i] |= lo;
+  std::fill(blocks.begin() + i + 1, blocks.begin() + j, word_type::all);
+  blocks[j] |= hi;
+}
+
+// Finds the first position at or after i that has a given bit value, or
+// returns chunk_size if there is none.
+size_t scan(const std::vector<block_type>& blocks, size_t i, bool bit) {
+  auto b = i / width;
+  if (b >= chunk_blocks)
+    return chunk_size;
+  auto x = (bit ? blocks[b] : ~blocks[b]) & (word_type::all << (i % width));
+  while (x == 0) {
+    if (++b == chunk_blocks)
+      return chunk_size;
+    x = bit ? blocks[b] : ~blocks[b];
+  }
+  return b * width + word_type::count_trailing_zeros(x);
+}
+
+// -- container utilities ------------------------------------------------------
+
+size_type cardinality(const container& x) {
+  auto f = detail::overload(
+    [](const array_container& xs) -> size_type { return xs.values.size(); },
+    [](const bitset_container& xs) {
+      auto result = size_type{0};
+      for (auto block : xs.blocks)
+        result += word_type::popcount(block);
+      return result;
+    },
+    [](const run_container& xs) {
+      auto result = size_type{0};
+      for (auto& r : xs.runs)
+        result += r.last - r.first + 1u;
+      return result;
+    },
+    [](const full_container& xs) { return xs.chunks * chunk_size; });
+  return caf::visit(f, x);
+}
+
+bool is_empty(const container& x) {
+  auto f = detail::overload(
+    [](const array_container& xs) { return xs.values.empty(); },
+    [](const bitset_container& xs) {
+      return std::all_of(xs.blocks.begin(), xs.blocks.end(),
+                         [](auto block) { return block == 0; });
+    },
+    [](const run_container& xs) { return xs.runs.empty(); },
+    [](const full_container&) { return false; });
+  return caf::visit(f, x);
+}
+
+bool is_full(const container& x) {
+  auto f = detail::overload(
+    [](const array_container&) { return false; },
+    [](const bitset_container& xs) {
+      return std::all_of(xs.blocks.begin(), xs.blocks.end(),
+                         [](auto block) { return block == word_type::all; });
+    },
+    [](const run_container& xs) {
+      return xs.runs.size() == 1 && xs.runs[0].first == 0
+             && xs.runs[0].last == chunk_size - 1;
+    },
+    [](const full_container&) { return true; });
+  return caf::visit(f, x);
+}
+
+bitset_container to_bitset(const container& x) {
+  auto f = detail::overload(
+    [](const array_container& xs) {
+      bitset_container result;
+      result.blocks.resize(chunk_blocks);
+      for (auto i : xs.values)
+        result.blocks[i / width] |= word_type::mask(i % width);
+      return result;
+    },
+    [](const bitset_container& xs) { return xs; },
+    [](const run_container& xs) {
+      bitset_container result;
+      result.blocks.resize(chunk_blocks);
+      for (auto& r : xs.runs)
+        set_bits(result.blocks, r.first, r.last + 1u);
+      return result;
+    },
+    [](const full_container&) {
+      return bitset_container{std::vector<block_type>(chunk_blocks,
+                                                      word_type::all)};
+    });
+  return caf::visit(f, x);
+}
+
+run_container to_runs(const std::vector<uint16_t>& values) {
+  run_container result;
+  for (auto i : values)
+    if (!result.runs.empty() && result.runs.back().last + 1u == i)
+      result.runs.back().last = i;
+    else
+      result.runs.push_back({i, i});
+  return result;
+}
+
+// Picks the smallest container for the contents of a bitset, assuming 2
+// bytes per array position, 4 bytes per run, and 8 KiB per bitset. Returns
+// an empty array if the bitset has no 1-bits.
+container optimize(bitset_container&& x) {
+  auto count = size_t{0};
+  auto runs = size_t{0};
+  auto carry = block_type{0};
+  for (auto block : x.blocks) {
+    count += word_type::popcount(block);
+    // A run begins at every 1-bit whose predecessor is a 0-bit.
+    runs += word_type::popcount(block & ~((block << 1) | carry));
+    carry = block >> (width - 1);
+  }
+  if (runs <= max_runs && 2 * runs <= count) {
+    run_container result;
+    result.runs.reserve(runs);
+    for (auto i = scan(x.blocks, 0, true); i < chunk_size;) {
+      auto j = scan(x.blocks, i, false);
+      result.runs.push_back({static_cast<uint16_t>(i),
+                             static_cast<uint16_t>(j - 1)});
+      i = scan(x.blocks, j, true);
+    }
+    return result;
+  }
+  if (count <= max_array_size) {
+    array_container result;
+    result.values.reserve(count);
+    for (size_t i = 0; i < chunk_blocks; ++i)
+      for (auto block = x.blocks[i]; block != 0; block &= block - 1) {
+        auto j = i * width + word_type::count_trailing_zeros(block);
+        result.values.push_back(static_cast<uint16_t>(j));
+      }
+    return result;
+  }
+  return std::move(x);
+}
+
+bool same_bits(const container& x, const container& y) {
+  if (auto xs = caf::get_if<array_container>(&x))
+    if (auto ys = caf::get_if<array_container>(&y))
+      return xs->values == ys->values;
+  if (auto xs = caf::get_if<run_container>(&x))
+    if (auto ys = caf::get_if<run_container>(&y))
+      return std::equal(xs->runs.begin(), xs->runs.end(), ys->runs.begin(),
+                        ys->runs.end(), [](auto& r, auto& s) {
+                          return r.first == s.first && r.last == s.last;
+                        });
+  return to_bitset(x).blocks == to_bitset(y).blocks;
+}
+
+// Appends a position after all 1-bits of a container.
+void insert_back(container& x, uint16_t i) {
+  if (auto xs = caf::get_if<array_container>(&x)) {
+    xs->values.push_back(i);
+    if (xs->values.size() > max_array_size)
+      x = to_bitset(x);
+  } else if (auto xs = caf::get_if<bitset_container>(&x)) {
+    xs->blocks[i / width] |= word_type::mask(i % width);
+  } else {
+    auto& runs = caf::get<run_container>(x).runs;
+    if (!runs.empty() && runs.back().last + 1u == i) {
+      runs.back().last = i;
+    } else {
+      runs.push_back({i, i});
+      if (runs.size() > max_runs)
+        x = to_bitset(x);
+    }
+  }
+}
+
+// Appends the positions [first, last] after all 1-bits of a container.
+void insert_back(container& x, uint16_t first, uint16_t last) {
+  if (auto xs = caf::get_if<array_container>(&x))
+    x = to_runs(xs->values);
+  if (auto xs = caf::get_if<bitset_container>(&x)) {
+    set_bits(xs->blocks, first, last + 1u);
+    return;
+  }
+  auto& runs = caf::get<run_container>(x).runs;
+  if (!runs.empty() && runs.back().last + 1u == first) {
+    runs.back().last = last;
+  } else {
+    runs.push_back({first, last});
+    if (runs.size() > max_runs)
+      x = to_bitset(x);
+  }
+}
+
+// Removes all bits at and after position i from a bitset.
+void truncate(bitset_container& x, size_t i) {
+  if (i >= chunk_size)
+    return;
+  auto b = i / width;
+  x.blocks[b] &= word_type::lsb_mask(i % width);
+  std::fill(x.blocks.begin() + b + 1, x.blocks.end(), block_type{0});
+}
+
+// Computes the complement of a container within the first *valid* bits of a
+// chunk.
+container complement(const container& x, size_t valid = chunk_size) {
+  auto xs = to_bitset(x);
+  for (auto& block : xs.blocks)
+    block = ~block;
+  truncate(xs, valid);
+  return optimize(std::move(xs));
+}
+
+container combine(const container& x, const container& y,
+                  detail::block_operation op) {
+  using detail::block_operation;
+  auto xs = caf::get_if<array_container>(&x);
+  auto ys = caf::get_if<array_container>(&y);
+  if (xs != nullptr && ys != nullptr) {
+    array_container result;
+    auto& lhs = xs->values;
+    auto& rhs = ys->values;
+    auto out = std::back_inserter(result.values);
+    switch (op) {
+      case block_operation::and_op:
+        std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                              out);
+        break;
+      case block_operation::or_op:
+        std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), out);
+        break;
+      case block_operation::xor_op:
+        std::set_symmetric_difference(lhs.begin(), lhs.end(), rhs.begin(),
+                                      rhs.end(), out);
+        break;
+      case block_operation::and_not_op:
+        std::set_difference(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                            out);
+        break;
+    }
+    if (result.values.size() <= max_array_size)
+      return result;
+    return optimize(to_bitset(container{std::move(result)}));
+  }
+  if (xs != nullptr && (op == block_operation::and_op
+                        || op == block_operation::and_not_op)) {
+    // The result is a subset of the array, so we only probe the other side.
+    auto bits = to_bitset(y);
+    auto keep = op == block_operation::and_op;
+    array_container result;
+    for (auto i : xs->values)
+      if (word_type::test(bits.blocks[i / width], i % width) == keep)
+        result.values.push_back(i);
+    return result;
+  }
+  auto result = to_bitset(x);
+  auto rhs = to_bitset(y);
+  detail::simd_block_kernels()[op](result.blocks.data(), rhs.blocks.data(),
+                                   result.blocks.data(), chunk_blocks);
+  return optimize(std::move(result));
+}
+
+// -- chunk utilities ----------------------------------------------------------
+
+// Checks whether a chunk covers several keys with all bits set.
+bool is_span(const chunk& x) {
+  return caf::holds_alternative<full_container>(x.data);
+}
+
+// Returns the key after the last key that a chunk covers.
+size_type end_key(const chunk& x) {
+  auto xs = caf::get_if<full_container>(&x.data);
+  return x.key + (xs != nullptr ? xs->chunks : 1);
+}
+
+// Appends a chunk after all others, and merges it into its predecessor if
+// both have all bits set.
+void push_chunk(std::vector<chunk>& xs, chunk x) {
+  if (!xs.empty() && end_key(xs.back()) == x.key && is_full(x.data)
+      && is_full(xs.back().data)) {
+    auto n = end_key(x) - xs.back().key;
+    xs.back().data = full_container{n};
+    return;
+  }
+  xs.push_back(std::move(x));
+}
+
+// Appends *n* chunks with all bits set, beginning at a given key.
+void push_full(std::vector<chunk>& xs, size_type key, size_type n) {
+  VAST_ASSERT(n > 0);
+  if (n == 1)
+    push_chunk(xs, {key, run_container{{{0, chunk_size - 1}}}});
+  else
+    push_chunk(xs, {key, full_container{n}});
+}
+
+// Moves past the first *n* keys of the chunk at *i*, where *key* is the
+// first key that remains.
+template <class Iterator>
+void consume(Iterator& i, Iterator last, size_type& key, size_type n) {
+  key += n;
+  if (key == end_key(*i) && ++i != last)
+    key = i->key;
+}
+
+} // namespace <anonymous>
+
+roaring_bitmap::roaring_bitmap(size_type n, bool bit) {
+  append_bits(bit, n);
+}
+
+bool roaring_bitmap::empty() const {
+  return size_ == 0;
+}
+
+roaring_bitmap::size_type roaring_bitmap::size() const {
+  return size_;
+}
+
+const std::vector<roaring_bitmap::chunk>& roaring_bitmap::chunks() const {
+  return chunks_;
+}
+
+roaring_bitmap::size_type roaring_bitmap::count() const {
+  auto result = size_type{0};
+  for (auto& x : chunks_)
+    result += cardinality(x.data);
+  return result;
+}
+
+roaring_bitmap::size_type roaring_bitmap::count(size_type i) const {
+  VAST_ASSERT(i < size_);
+  auto key = i / chunk_size;
+  auto offset = i % chunk_size;
+  auto result = size_type{0};
+  for (auto& x : chunks_) {
+    if (x.key > key)
+      break;
+    if (end_key(x) <= key) {
+      result += cardinality(x.data);
+      continue;
+    }
+    auto f = detail::overload(
+      [&](const array_container& xs) -> size_type {
+        auto& values = xs.values;
+        return std::upper_bound(values.begin(), values.end(), offset)
+               - values.begin();
+      },
+      [&](const bitset_container& xs) {
+        auto b = offset / width;
+        auto n = rank<1>(xs.blocks[b], offset % width);
+        for (size_t j = 0; j < b; ++j)
+          n += word_type::popcount(xs.blocks[j]);
+        return n;
+      },
+      [&](const run_container& xs) {
+        auto n = size_type{0};
+        for (auto& r : xs.runs) {
+          if (r.first > offset)
+            break;
+          n += std::min<size_type>(r.last, offset) - r.first + 1;
+        }
+        return n;
+      },
+      [&](const full_container&) { return i - x.key * chunk_size + 1; });
+    result += caf::visit(f, x.data);
+    break;
+  }
+  return result;
+}
+
+roaring_bitmap::size_type roaring_bitmap::find(size_type i) const {
+  VAST_ASSERT(i > 0);
+  for (auto& x : chunks_) {
+    auto n = cardinality(x.data);
+    if (i > n) {
+      i -= n;
+      continue;
+    }
+    auto f = detail::overload(
+      [&](const array_container& xs) -> size_type {
+        return xs.values[i - 1];
+      },
+      [&](const bitset_container& xs) -> size_type {
+        for (size_t b = 0; b < chunk_blocks; ++b) {
+          auto ones = word_type::popcount(xs.blocks[b]);
+          if (i <= ones)
+            return b * width + select<1>(xs.blocks[b], i);
+          i -= ones;
+        }
+        return word_type::npos;
+      },
+      [&](const run_container& xs) -> size_type {
+        for (auto& r : xs.runs) {
+          auto ones = r.last - r.first + size_type{1};
+          if (i <= ones)
+            return r.first + i - 1;
+          i -= ones;
+        }
+        return word_type::npos;
+      },
+      [&](const full_container&) { return i - 1; });
+    return x.key * chunk_size + caf::visit(f, x.data);
+  }
+  return word_type::npos;
+}
+
+roaring_bitmap::size_type roaring_bitmap::find_last() const {
+  if (chunks_.empty())
+    return word_type::npos;
+  auto f = detail::overload(
+    [](const array_container& xs) -> size_type { return xs.values.back(); },
+    [](const bitset_container& xs) -> size_type {
+      for (auto b = chunk_blocks; b > 0; --b)
+        if (xs.blocks[b - 1] != 0)
+          return (b - 1) * width + vast::find_last<1>(xs.blocks[b - 1]);
+      return word_type::npos;
+    },
+    [](const run_container& xs) -> size_type { return xs.runs.back().last; },
+    [](const full_container& xs) { return xs.chunks * chunk_size - 1; });
+  auto& x = chunks_.back();
+  return x.key * chunk_size + caf::visit(f, x.data);
+}
+
+void roaring_bitmap::append_bit(bool bit) {
+  VAST_ASSERT(size_ < max_size);
+  if (bit)
+    add(size_);
+  ++size_;
+}
+
+void roaring_bitmap::append_bits(bool bit, size_type n) {
+  VAST_ASSERT(size_ + n <= max_size);
+  if (bit && n > 0)
+    add(size_, n);
+  size_ += n;
+}
+
+void roaring_bitmap::append_block(block_type bits, size_type n) {
+  VAST_ASSERT(size_ + n <= max_size);
+  VAST_ASSERT(n <= word_type::width);
+  if (n < word_type::width)
+    bits &= word_type::lsb_mask(n);
+  if (bits == word_type::all)
+    add(size_, n);
+  else
+    for (; bits != 0; bits &= bits - 1)
+      add(size_ + word_type::count_trailing_zeros(bits));
+  size_ += n;
+}
+
+void roaring_bitmap::flip() {
+  std::vector<chunk> result;
+  auto full_chunks = size_ / chunk_size;
+  // Absent chunks have no 1-bits and thus become full. A trailing partial
+  // chunk becomes a single run up to the end of the bitmap.
+  auto fill = [&](size_type first, size_type last) {
+    if (first < std::min(last, full_chunks))
+      push_full(result, first, std::min(last, full_chunks) - first);
+    if (last > full_chunks) {
+      auto valid = size_ - full_chunks * chunk_size;
+      auto last = static_cast<uint16_t>(valid - 1);
+      result.push_back({full_chunks, run_container{{{0, last}}}});
+    }
+  };
+  auto key = size_type{0};
+  for (auto& x : chunks_) {
+    if (key < x.key)
+      fill(key, x.key);
+    key = end_key(x);
+    if (is_span(x))
+      continue;
+    auto valid = std::min(chunk_size, size_ - x.key * chunk_size);
+    auto y = complement(x.data, valid);
+    if (!is_empty(y))
+      push_chunk(result, {x.key, std::move(y)});
+  }
+  auto num_chunks = (size_ + chunk_size - 1) / chunk_size;
+  if (key < num_chunks)
+    fill(key, num_chunks);
+  chunks_ = std::move(result);
+}
+
+bool operator==(const roaring_bitmap& x, const roaring_bitmap& y) {
+  auto f = [](auto& lhs, auto& rhs) {
+    return lhs.key == rhs.key && same_bits(lhs.data, rhs.data);
+  };
+  return x.size_ == y.size_
+         && std::equal(x.chunks_.begin(), x.chunks_.end(), y.chunks_.begin(),
+                       y.chunks_.end(), f);
+}
+
+void roaring_bitmap::add(size_type i) {
+  auto key = i / chunk_size;
+  auto offset = static_cast<uint16_t>(i % chunk_size);
+  if (chunks_.empty() || chunks_.back().key != key) {
+    chunks_.push_back({key, array_container{{offset}}});
+    return;
+  }
+  insert_back(chunks_.back().data, offset);
+  // Only setting the last bit of a chunk can make it full.
+  if (offset == chunk_size - 1)
+    merge_back();
+}
+
+void roaring_bitmap::add(size_type first, size_type n) {
+  auto last = first + n;
+  while (first < last) {
+    auto key = first / chunk_size;
+    if (first % chunk_size == 0 && last - first >= chunk_size) {
+      auto keys = (last - first) / chunk_size;
+      push_full(chunks_, key, keys);
+      first += keys * chunk_size;
+      continue;
+    }
+    auto end = std::min(last, (key + 1) * chunk_size);
+    auto lo = static_cast<uint16_t>(first % chunk_size);
+    auto hi = static_cast<uint16_t>((end - 1) % chunk_size);
+    if (chunks_.empty() || chunks_.back().key != key) {
+      chunks_.push_back({key, run_container{{{lo, hi}}}});
+    } else {
+      insert_back(chunks_.back().data, lo, hi);
+      if (hi == chunk_size - 1)
+        merge_back();
+    }
+    first = end;
+  }
+}
+
+void roaring_bitmap::merge_back() {
+  if (chunks_.size() < 2)
+    return;
+  auto x = std::move(chunks_.back());
+  chunks_.pop_back();
+  push_chunk(chunks_, std::move(x));
+}
+
+roaring_bitmap_range::roaring_bitmap_range(const roaring_bitmap& bm)
+  : bm_{&bm} {
+  if (!done())
+    scan();
+}
+
+void roaring_bitmap_range::next() {
+  position_ += bits_.size();
+  if (!done())
+    scan();
+}
+
+bool roaring_bitmap_range::done() const {
+  return bm_ == nullptr || position_ >= bm_->size_;
+}
+
+void roaring_bitmap_range::scan() {
+  auto& chunks = bm_->chunks_;
+  auto size = bm_->size_;
+  // Skip all chunks that end before the current position.
+  while (chunk_ < chunks.size()
+         && end_key(chunks[chunk_]) * chunk_size <= position_) {
+    ++chunk_;
+    cursor_ = 0;
+  }
+  // Produce a 0-run up to the next chunk if there is a gap.
+  if (chunk_ == chunks.size() || chunks[chunk_].key * chunk_size > position_) {
+    auto end = chunk_ == chunks.size()
+                 ? size
+                 : std::min(size, chunks[chunk_].key * chunk_size);
+    bits_ = {word_type::none, end - position_};
+    return;
+  }
+  // Within a chunk, array and bitset containers produce aligned blocks,
+  // whereas run containers produce runs of arbitrary length.
+  auto base = chunks[chunk_].key * chunk_size;
+  auto end = std::min(size, base + chunk_size);
+  auto offset = position_ - base;
+  auto& x = chunks[chunk_].data;
+  if (is_span(chunks[chunk_])) {
+    bits_ = {word_type::all, end_key(chunks[chunk_]) * chunk_size - position_};
+  } else if (auto xs = caf::get_if<array_container>(&x)) {
+    auto& values = xs->values;
+    while (cursor_ < values.size() && values[cursor_] < offset)
+      ++cursor_;
+    if (cursor_ == values.size()) {
+      bits_ = {word_type::none, end - position_};
+      return;
+    }
+    auto block = values[cursor_] / width * width;
+    if (block > offset) {
+      bits_ = {word_type::none, base + block - position_};
+      return;
+    }
+    auto data = word_type::none;
+    for (auto i = cursor_; i < values.size() && values[i] < block + width; ++i)
+      data |= word_type::mask(values[i] % width);
+    bits_ = {data, std::min<size_type>(width, end - position_)};
+  } else if (auto xs = caf::get_if<bitset_container>(&x)) {
+    auto& blocks = xs->blocks;
+    auto i = offset / width;
+    auto data = blocks[i];
+    if (word_type::all_or_none(data)) {
+      auto j = i + 1;
+      while (j < chunk_blocks && blocks[j] == data)
+        ++j;
+      bits_ = {data, std::min(base + j * width, end) - position_};
+    } else {
+      bits_ = {data, std::min<size_type>(width, end - position_)};
+    }
+  } else {
+    auto& runs = caf::get<run_container>(x).runs;
+    while (cursor_ < runs.size() && runs[cursor_].last < offset)
+      ++cursor_;
+    if (cursor_ == runs.size())
+      bits_ = {word_type::none, end - position_};
+    else if (runs[cursor_].first > offset)
+      bits_ = {word_type::none, base + runs[cursor_].first - position_};
+    else
+      bits_ = {word_type::all, base + runs[cursor_].last + 1 - position_};
+  }
+}
+
+roaring_bitmap_range bit_range(const roaring_bitmap& bm) {
+  return roaring_bitmap_range{bm};
+}
+
+roaring_bitmap binary_eval(const roaring_bitmap& lhs,
+                           const roaring_bitmap& rhs,
+                           detail::block_operation op) {
+  using detail::block_operation;
+  // Chunks on one side only meet zeros on the other side.
+  auto keep_lhs = op != block_operation::and_op;
+  auto keep_rhs = op == block_operation::or_op
+                  || op == block_operation::xor_op;
+  roaring_bitmap result;
+  auto& out = result.chunks_;
+  // Appends the keys [key, key + n) of a chunk to the result.
+  auto copy = [&](const chunk& x, size_type key, size_type n) {
+    if (is_span(x))
+      push_full(out, key, n);
+    else
+      push_chunk(out, x);
+  };
+  auto put = [&](size_type key, container data) {
+    if (!is_empty(data))
+      push_chunk(out, {key, std::move(data)});
+  };
+  // We walk both sides key by key, where a span of full chunks may cover the
+  // keys of several chunks on the other side.
+  auto x = lhs.chunks_.begin();
+  auto y = rhs.chunks_.begin();
+  auto x_end = lhs.chunks_.end();
+  auto y_end = rhs.chunks_.end();
+  auto i = x != x_end ? x->key : 0;
+  auto j = y != y_end ? y->key : 0;
+  while (x != x_end && y != y_end) {
+    if (i < j) {
+      auto n = std::min(end_key(*x), j) - i;
+      if (keep_lhs)
+        copy(*x, i, n);
+      consume(x, x_end, i, n);
+    } else if (j < i) {
+      auto n = std::min(end_key(*y), i) - j;
+      if (keep_rhs)
+        copy(*y, j, n);
+      consume(y, y_end, j, n);
+    } else {
+      auto n = std::min(end_key(*x), end_key(*y)) - i;
+      if (is_span(*x) && is_span(*y)) {
+        if (op == block_operation::and_op || op == block_operation::or_op)
+          push_full(out, i, n);
+      } else if (is_span(*x)) {
+        if (op == block_operation::and_op)
+          put(i, y->data);
+        else if (op == block_operation::or_op)
+          push_full(out, i, n);
+        else
+          put(i, complement(y->data));
+      } else if (is_span(*y)) {
+        if (op == block_operation::and_op)
+          put(i, x->data);
+        else if (op == block_operation::or_op)
+          push_full(out, i, n);
+        else if (op == block_operation::xor_op)
+          put(i, complement(x->data));
+      } else {
+        put(i, combine(x->data, y->data, op));
+      }
+      consume(x, x_end, i, n);
+      consume(y, y_end, j, n);
+    }
+  }
+  if (keep_lhs && x != x_end) {
+    copy(*x, i, end_key(*x) - i);
+    std::for_each(x + 1, x_end, [&](auto& z) { push_chunk(out, z); });
+  }
+  if (keep_rhs && y != y_end) {
+    copy(*y, j, end_key(*y) - j);
+    std::for_each(y + 1, y_end, [&](auto& z) { push_chunk(out, z); });
+  }
+  result.size_ = std::max(lhs.size_, rhs.size_);
+  return result;
+}
+
+roaring_bitmap binary_and(const roaring_bitmap& lhs,
+                          const roaring_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::and_op);
+}
+
+roaring_bitmap binary_or(const roaring_bitmap& lhs,
+                         const roaring_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::or_op);
+}
+
+roaring_bitmap binary_xor(const roaring_bitmap& lhs,
+                          const roaring_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::xor_op);
+}
+
+roaring_bitmap binary_nand(const roaring_bitmap& lhs,
+                           const roaring_bitmap& rhs) {
+  return binary_eval(lhs, rhs, detail::block_operation::and_not_op);
+}
+
+} // namespace vast
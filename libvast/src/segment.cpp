@@ -11,52 +11,304 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include "vast/segment.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include <caf/deserializer.hpp>
+#include <caf/serializer.hpp>
 #include <caf/stream_deserializer.hpp>
 #include <caf/streambuf.hpp>
 
 #include "vast/bitmap.hpp"
 #include "vast/bitmap_algorithms.hpp"
+#include "vast/data.hpp"
+#include "vast/default_table_slice.hpp"
+#include "vast/error.hpp"
+#include "vast/factory.hpp"
 #include "vast/ids.hpp"
 #include "vast/logger.hpp"
-#include "vast/segment.hpp"
-#include "vast/si_literals.hpp"
+#include "vast/policy/column_major.hpp"
+#include "vast/policy/row_major.hpp"
 #include "vast/table_slice.hpp"
+#include "vast/table_slice_builder.hpp"
+#include "vast/table_slice_builder_factory.hpp"
+#include "vast/table_slice_factory.hpp"
+#include "vast/view.hpp"
 
 #include "vast/detail/assert.hpp"
-#include "vast/detail/byte_swap.hpp"
 #include "vast/detail/narrow.hpp"
 
 namespace vast {
 
-using namespace binary_byte_literals;
+namespace {
+
+// -- legacy formats -----------------------------------------------------------
+
+// The per-slice meta data of version 1, which predates compression.
+struct v1_table_slice_synopsis {
+  int64_t start;
+  int64_t end;
+  id offset;
+  uint64_t size;
+};
+
+template <class Inspector>
+auto inspect(Inspector& f, v1_table_slice_synopsis& x) {
+  return f(x.start, x.end, x.offset, x.size);
+}
+
+// The per-slice meta data of version 2.
+struct v2_table_slice_synopsis {
+  int64_t start;
+  int64_t end;
+  id offset;
+  uint64_t size;
+  int64_t uncompressed_start;
+  int64_t uncompressed_end;
+};
+
+template <class Inspector>
+auto inspect(Inspector& f, v2_table_slice_synopsis& x) {
+  return f(x.start, x.end, x.offset, x.size, x.uncompressed_start,
+           x.uncompressed_end);
+}
+
+// Deserializes the variable-size meta data of version 1 and 2 into footer
+// entries. The layout digests remain zero, because these versions did not
+// record them.
+caf::error read_legacy_meta_data(caf::deserializer& source,
+                                 segment_version_type version,
+                                 compression& method,
+                                 std::vector<segment_slice_entry>& entries) {
+  using detail::narrow_cast;
+  entries.clear();
+  if (version == 1) {
+    std::vector<v1_table_slice_synopsis> xs;
+    if (auto error = source(xs))
+      return error;
+    method = compression::null;
+    for (auto& x : xs) {
+      auto size = narrow_cast<uint64_t>(x.end - x.start);
+      entries.push_back({x.offset, x.size, narrow_cast<uint64_t>(x.start),
+                         narrow_cast<uint64_t>(x.end), size, 0});
+    }
+    return caf::none;
+  }
+  std::vector<v2_table_slice_synopsis> xs;
+  if (auto error = source(method, xs))
+    return error;
+  for (auto& x : xs) {
+    auto size = narrow_cast<uint64_t>(x.uncompressed_end
+                                      - x.uncompressed_start);
+    entries.push_back({x.offset, x.size, narrow_cast<uint64_t>(x.start),
+                       narrow_cast<uint64_t>(x.end), size, 0});
+  }
+  return caf::none;
+}
+
+// The last version in which default and matrix table slices encode each cell
+// generically.
+constexpr segment_version_type generic_cells_version = 3;
+
+// Loads a table slice from a segment of version 3 or earlier. Default and
+// matrix table slices encoded their cells one `data` value at a time back
+// then, so we rebuild them with the current encoding.
+caf::expected<table_slice_ptr> make_legacy_slice(chunk_ptr bytes) {
+  auto buf_data = const_cast<char*>(bytes->data()); // CAF won't touch it.
+  caf::charbuf buf{buf_data, bytes->size()};
+  caf::stream_deserializer<caf::charbuf&> source{buf};
+  caf::atom_value id;
+  table_slice_header header;
+  if (auto error = source(id, header))
+    return error;
+  auto rows = detail::narrow_cast<size_t>(header.rows);
+  auto columns = header.layout.fields.size();
+  // Collect the cells in row-major order.
+  std::vector<data> cells;
+  if (id == default_table_slice::class_id) {
+    vector xs;
+    if (auto error = source(xs))
+      return error;
+    if (xs.size() != rows)
+      return make_error(ec::format_error, "got invalid legacy table slice");
+    cells.reserve(rows * columns);
+    for (auto& x : xs) {
+      auto row = caf::get_if<vector>(&x);
+      if (row == nullptr || row->size() != columns)
+        return make_error(ec::format_error, "got invalid legacy table slice");
+      std::move(row->begin(), row->end(), std::back_inserter(cells));
+    }
+  } else if (id == policy::row_major<data>::class_id
+             || id == policy::column_major<data>::class_id) {
+    std::vector<data> xs(rows * columns);
+    for (auto& x : xs)
+      if (auto error = source(x))
+        return error;
+    if (id == policy::row_major<data>::class_id) {
+      cells = std::move(xs);
+    } else {
+      cells.reserve(xs.size());
+      for (size_t row = 0; row < rows; ++row)
+        for (size_t col = 0; col < columns; ++col)
+          cells.push_back(std::move(xs[col * rows + row]));
+    }
+  } else {
+    // All other implementations have the same encoding as before.
+    auto result = factory<table_slice>::traits::make(std::move(bytes));
+    if (result == nullptr)
+      return make_error(ec::format_error, "failed to load table slice");
+    return result;
+  }
+  auto builder = factory<table_slice_builder>::make(id, header.layout);
+  if (builder == nullptr)
+    return make_error(ec::format_error, "failed to rebuild legacy table slice");
+  for (auto& x : cells)
+    if (!builder->add(make_view(x)))
+      return make_error(ec::format_error, "got invalid legacy table slice");
+  auto result = builder->finish();
+  if (result == nullptr)
+    return make_error(ec::format_error, "failed to rebuild legacy table slice");
+  result.unshared().offset(header.offset);
+  return result;
+}
+
+// -- current format -----------------------------------------------------------
+
+size_t align(size_t n) {
+  return (n + alignof(segment_slice_entry) - 1)
+         & ~(alignof(segment_slice_entry) - 1);
+}
+
+// Assembles a segment in the current layout from the parts of a segment of
+// version 1 or 2.
+chunk_ptr make_image(const uuid& id, compression method,
+                     const std::vector<segment_slice_entry>& entries,
+                     const char* payload, size_t payload_size) {
+  auto footer_offset = align(segment::payload_offset + payload_size);
+  auto footer_size = entries.size() * sizeof(segment_slice_entry);
+  std::vector<char> buf(footer_offset + footer_size, 0);
+  // The payload of converted segments still holds legacy table slices.
+  segment_header header{segment::magic, generic_cells_version, id,
+                        segment::payload_offset};
+  segment_index_descriptor descriptor{footer_offset, entries.size(), method,
+                                      {}};
+  std::memcpy(buf.data(), &header, sizeof(header));
+  std::memcpy(buf.data() + sizeof(header), &descriptor, sizeof(descriptor));
+  std::memcpy(buf.data() + segment::payload_offset, payload, payload_size);
+  std::memcpy(buf.data() + footer_offset, entries.data(), footer_size);
+  return chunk::make(std::move(buf));
+}
+
+// The highest compression ratio of all supported methods. LZ4 extends a match
+// by at most 255 bytes per input byte, and Snappy compresses less.
+constexpr uint64_t max_compression_ratio = 255;
+
+// Checks whether a compression method from a segment is known.
+bool is_valid(compression method) {
+  switch (method) {
+    case compression::null:
+    case compression::lz4:
+#ifdef VAST_HAVE_SNAPPY
+    case compression::snappy:
+#endif
+      return true;
+  }
+  return false;
+}
+
+// Checks whether a footer entry describes a table slice within the payload.
+bool is_valid(const segment_slice_entry& x, compression method,
+              uint64_t payload_size) {
+  if (x.start > x.end || x.end > payload_size)
+    return false;
+  auto size = x.end - x.start;
+  if (method == compression::null)
+    return x.uncompressed_size == size;
+  return x.uncompressed_size <= size * max_compression_ratio;
+}
+
+// Checks whether a chunk starts with a segment header in the current format.
+bool has_native_magic(const chunk& x) {
+  if (x.size() < sizeof(segment_header))
+    return false;
+  segment_magic_type magic;
+  std::memcpy(&magic, x.data(), sizeof(magic));
+  return magic == segment::magic;
+}
+
+} // namespace <anonymous>
 
 segment_ptr segment::make(chunk_ptr chunk) {
   VAST_ASSERT(chunk != nullptr);
-  // Setup a CAF deserializer
-  auto data = const_cast<char*>(chunk->data()); // CAF won't touch it.
-  caf::charbuf buf{data, chunk->size()};
-  caf::stream_deserializer<caf::charbuf&> source{buf};
+  if (!has_native_magic(*chunk)) {
+    // Segments of version 1 and 2 start with a CAF-serialized header.
+    auto data = const_cast<char*>(chunk->data()); // CAF won't touch it.
+    caf::charbuf buf{data, chunk->size()};
+    caf::stream_deserializer<caf::charbuf&> source{buf};
+    segment_ptr result;
+    if (auto error = inspect(source, result)) {
+      VAST_ERROR_ANON(__func__, "failed to deserialize segment");
+      return nullptr;
+    }
+    return result;
+  }
+  if (chunk->size() < payload_offset) {
+    VAST_ERROR_ANON(__func__, "got truncated segment");
+    return nullptr;
+  }
+  // The footer entries must be properly aligned for direct access, which
+  // can only fail for chunks that do not start at an aligned address.
+  auto address = reinterpret_cast<uintptr_t>(chunk->data());
+  if (address % alignof(segment_slice_entry) != 0)
+    chunk = chunk::make(std::vector<char>(chunk->begin(), chunk->end()));
   auto result = segment_ptr{new segment, false};
-  if (auto error = source(result->header_, result->meta_)) {
-    VAST_ERROR_ANON(__func__, "failed to deserialize segment meta data");
+  std::memcpy(&result->header_, chunk->data(), sizeof(segment_header));
+  if (result->header_.version < generic_cells_version
+      || result->header_.version > version) {
+    VAST_ERROR_ANON(__func__, "got unsupported segment version",
+                    result->header_.version);
     return nullptr;
   }
-  if (result->magic != magic) {
-    VAST_ERROR_ANON(__func__, "got invalid segment magic", result->magic);
+  segment_index_descriptor descriptor;
+  std::memcpy(&descriptor, chunk->data() + sizeof(segment_header),
+              sizeof(descriptor));
+  // Bound the number of slices by the chunk size first, so that computing
+  // the footer size cannot overflow.
+  auto max_slices = chunk->size() / sizeof(segment_slice_entry);
+  if (descriptor.num_slices > max_slices) {
+    VAST_ERROR_ANON(__func__, "got invalid segment footer");
     return nullptr;
   }
-  if (result->version > version) {
-    VAST_ERROR_ANON(__func__, "got newer segment version", result->version);
+  auto footer_size = descriptor.num_slices * sizeof(segment_slice_entry);
+  if (result->header_.payload_offset != payload_offset
+      || descriptor.footer_offset % alignof(segment_slice_entry) != 0
+      || descriptor.footer_offset < payload_offset
+      || descriptor.footer_offset != chunk->size() - footer_size) {
+    VAST_ERROR_ANON(__func__, "got invalid segment footer");
     return nullptr;
   }
-  // Skip meta data. Since the buffer following the chunk meta data was
-  // previously serialized as chunk pointer (uint32_t size + data), we have
-  // to add add sizeof(uint32_t) bytes to directly jump to the table slice
-  // data.
-  auto bytes_read = detail::narrow_cast<size_t>(buf.in_avail());
-  VAST_ASSERT(chunk->size() > bytes_read);
-  auto meta_size = chunk->size() - bytes_read;
-  result->chunk_ = chunk->slice(meta_size + sizeof(uint32_t));
+  if (!is_valid(descriptor.method)) {
+    VAST_ERROR_ANON(__func__, "got unknown compression method");
+    return nullptr;
+  }
+  auto slices = reinterpret_cast<const segment_slice_entry*>(
+    chunk->data() + descriptor.footer_offset);
+  auto payload_size = descriptor.footer_offset - payload_offset;
+  for (size_t i = 0; i < descriptor.num_slices; ++i) {
+    if (!is_valid(slices[i], descriptor.method, payload_size)) {
+      VAST_ERROR_ANON(__func__, "got invalid segment footer entry", i);
+      return nullptr;
+    }
+  }
+  result->method_ = descriptor.method;
+  result->slices_ = slices;
+  result->num_slices_ = descriptor.num_slices;
+  result->chunk_ = std::move(chunk);
   return result;
 }
 
@@ -69,49 +321,147 @@ chunk_ptr segment::chunk() const {
 }
 
 size_t segment::num_slices() const {
-  return meta_.slices.size();
+  return num_slices_;
+}
+
+compression segment::compression_method() const {
+  return method_;
+}
+
+span<const segment_slice_entry> segment::slices() const {
+  return {slices_, detail::narrow_cast<std::ptrdiff_t>(num_slices_)};
 }
 
 caf::expected<std::vector<table_slice_ptr>>
 segment::lookup(const ids& xs) const {
   std::vector<table_slice_ptr> result;
-  auto f = [](auto& slice) {
-    return std::pair{slice.offset, slice.offset + slice.size};
+  auto first = slices_;
+  auto last = slices_ + num_slices_;
+  auto ends_after = [](id x, const segment_slice_entry& slice) {
+    return x < slice.offset + slice.rows;
   };
-  auto g = [&](auto& slice) -> caf::error {
-    auto x = make_slice(slice);
+  auto rng = select(xs);
+  while (rng && first != last) {
+    // Jump to the first slice that ends after the current ID.
+    first = std::upper_bound(first, last, rng.get(), ends_after);
+    if (first == last)
+      break;
+    if (rng.get() < first->offset) {
+      // Make the ID range catch up if it's behind.
+      rng.next_from(first->offset);
+      continue;
+    }
+    auto x = make_slice(*first);
     if (!x)
       return x.error();
-    result.push_back(*x);
-    return caf::none;
-  };
-  auto begin = meta_.slices.begin();
-  auto end = meta_.slices.end();
-  if (auto error = select_with(xs, begin, end, f, g))
-    return error;
+    result.push_back(std::move(*x));
+    rng.next_from(first->offset + first->rows);
+    ++first;
+  }
   return result;
 }
 
 caf::expected<table_slice_ptr>
-segment::make_slice(const table_slice_synopsis& slice) const {
+segment::make_slice(const segment_slice_entry& slice) const {
   auto slice_size = detail::narrow_cast<size_t>(slice.end - slice.start);
-  // CAF won't touch the pointer during deserialization.
-  caf::charbuf buf{const_cast<char*>(chunk_->data()) + slice.start, slice_size};
-  caf::stream_deserializer<caf::charbuf&> deserializer{buf};
-  table_slice_ptr result;
-  if (auto error = deserializer(result))
-    return error;
+  auto bytes = chunk_->slice(payload_offset
+                               + detail::narrow_cast<size_t>(slice.start),
+                             slice_size);
+  if (method_ != compression::null) {
+    auto n = detail::narrow_cast<size_t>(slice.uncompressed_size);
+    std::vector<char> uncompressed(n);
+    if (!uncompress(method_, bytes->data(), slice_size, uncompressed.data(),
+                    n))
+      return make_error(ec::format_error, "failed to uncompress table slice");
+    bytes = chunk::make(std::move(uncompressed));
+  }
+  if (header_.version <= generic_cells_version)
+    return make_legacy_slice(std::move(bytes));
+  // Loading from a chunk allows table slice implementations to reference the
+  // (memory-mapped) bytes directly instead of deserializing them.
+  auto result = factory<table_slice>::traits::make(std::move(bytes));
+  if (result == nullptr)
+    return make_error(ec::format_error, "failed to load table slice");
   return result;
 }
 
 caf::error inspect(caf::serializer& sink, const segment_ptr& x) {
   VAST_ASSERT(x != nullptr);
-  return sink(x->header_, x->meta_, x->chunk_);
+  // The serialized form of a segment is its raw chunk, which allows for
+  // memory-mapping segment files directly.
+  auto data = const_cast<char*>(x->chunk_->data());
+  return sink.apply_raw(x->chunk_->size(), data);
 }
 
 caf::error inspect(caf::deserializer& source, segment_ptr& x) {
-  x.reset(new segment);
-  return source(x->header_, x->meta_, x->chunk_);
+  char header_bytes[sizeof(segment_header)];
+  if (auto error = source.apply_raw(sizeof(header_bytes), header_bytes))
+    return error;
+  segment_magic_type magic;
+  std::memcpy(&magic, header_bytes, sizeof(magic));
+  if (magic == segment::magic) {
+    // Read the index descriptor to determine the size of the segment.
+    char descriptor_bytes[sizeof(segment_index_descriptor)];
+    if (auto error = source.apply_raw(sizeof(descriptor_bytes),
+                                      descriptor_bytes))
+      return error;
+    segment_index_descriptor descriptor;
+    std::memcpy(&descriptor, descriptor_bytes, sizeof(descriptor));
+    // The descriptor comes from an untrusted source, so we bound the number
+    // of slices before computing the size to rule out an overflow.
+    auto max_slices = (std::numeric_limits<uint64_t>::max()
+                       - descriptor.footer_offset)
+                      / sizeof(segment_slice_entry);
+    if (descriptor.footer_offset < segment::payload_offset
+        || descriptor.num_slices > max_slices)
+      return make_error(ec::format_error, "got invalid segment size");
+    auto size = descriptor.footer_offset
+                + descriptor.num_slices * sizeof(segment_slice_entry);
+    // Grow the buffer only as the bytes arrive, such that a corrupt size
+    // fails on the first missing byte instead of allocating it up front.
+    constexpr uint64_t max_read_size = 1 << 20;
+    std::vector<char> buf(segment::payload_offset);
+    std::memcpy(buf.data(), header_bytes, sizeof(header_bytes));
+    std::memcpy(buf.data() + sizeof(header_bytes), descriptor_bytes,
+                sizeof(descriptor_bytes));
+    while (buf.size() < size) {
+      auto offset = buf.size();
+      auto n = std::min(size - offset, max_read_size);
+      buf.resize(offset + n);
+      if (auto error = source.apply_raw(n, buf.data() + offset))
+        return error;
+    }
+    x = segment::make(chunk::make(std::move(buf)));
+    if (x == nullptr)
+      return make_error(ec::format_error, "got invalid segment");
+    return caf::none;
+  }
+  // Convert segments of version 1 and 2, which begin with a CAF-serialized
+  // header followed by the CAF-serialized meta data and payload.
+  caf::charbuf header_buf{header_bytes, sizeof(header_bytes)};
+  caf::stream_deserializer<caf::charbuf&> header_source{header_buf};
+  segment_header header;
+  if (auto error = header_source(header))
+    return error;
+  if (header.magic != segment::magic)
+    return make_error(ec::format_error, "got invalid segment magic");
+  if (header.version > 2)
+    return make_error(ec::format_error, "got unsupported segment version");
+  auto method = compression::null;
+  std::vector<segment_slice_entry> entries;
+  chunk_ptr payload;
+  if (auto error = read_legacy_meta_data(source, header.version, method,
+                                         entries))
+    return error;
+  if (auto error = source(payload))
+    return error;
+  if (payload == nullptr)
+    return make_error(ec::format_error, "got segment without payload");
+  x = segment::make(make_image(header.id, method, entries, payload->data(),
+                               payload->size()));
+  if (x == nullptr)
+    return make_error(ec::format_error, "got invalid segment");
+  return caf::none;
 }
 
 } // namespace vast
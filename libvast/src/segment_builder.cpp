@@ -13,20 +13,34 @@
 
 #include "vast/segment_builder.hpp"
 
+#include <cstring>
+
+#include "vast/compression.hpp"
 #include "vast/error.hpp"
 #include "vast/ids.hpp"
 #include "vast/logger.hpp"
+#include "vast/packed_table_slice.hpp"
+#include "vast/packed_table_slice_builder.hpp"
 #include "vast/segment.hpp"
 #include "vast/table_slice.hpp"
+#include "vast/type.hpp"
+
+#include "vast/concept/hashable/uhash.hpp"
+#include "vast/concept/hashable/xxhash.hpp"
 
 #include "vast/detail/assert.hpp"
-#include "vast/detail/byte_swap.hpp"
 #include "vast/detail/narrow.hpp"
 
 namespace vast {
 
-segment_builder::segment_builder()
-  : table_slice_streambuf_{table_slice_buffer_},
+segment_builder::segment_builder(compression method, bool columnar,
+                                 bool dictionary_encoding)
+  : method_{method},
+    columnar_{columnar || dictionary_encoding},
+    dictionary_encoding_{dictionary_encoding},
+    // Without compression, we serialize directly into the segment buffer.
+    table_slice_streambuf_{method == compression::null ? table_slice_buffer_
+                                                       : uncompressed_buffer_},
     table_slice_serializer_{table_slice_streambuf_} {
   reset();
 }
@@ -34,31 +48,80 @@ segment_builder::segment_builder()
 caf::error segment_builder::add(table_slice_ptr x) {
   if (x->offset() < min_table_slice_offset_)
     return make_error(ec::unspecified, "slice offsets not increasing");
+  // Packed table slices store their cells column by column. Since we cannot
+  // tell whether an existing packed slice uses dictionaries, dictionary
+  // encoding re-encodes every slice.
+  auto y = x;
+  if (dictionary_encoding_
+      || (columnar_
+          && x->implementation_id() != packed_table_slice::class_id)) {
+    packed_table_slice_builder builder{x->layout(), dictionary_encoding_};
+    for (table_slice::size_type row = 0; row < x->rows(); ++row)
+      for (table_slice::size_type col = 0; col < x->columns(); ++col)
+        if (!builder.add(x->at(row, col)))
+          return make_error(ec::type_clash, "failed to re-encode table slice");
+    y = builder.finish();
+    if (y == nullptr)
+      return make_error(ec::unspecified, "failed to re-encode table slice");
+    y.unshared().offset(x->offset());
+  }
   auto before = table_slice_buffer_.size();
-  if (auto error = table_slice_serializer_(x)) {
-    table_slice_buffer_.resize(before);
-    return error;
+  auto uncompressed_size = size_t{0};
+  if (method_ == compression::null) {
+    if (auto error = table_slice_serializer_(y)) {
+      table_slice_buffer_.resize(before);
+      return error;
+    }
+    uncompressed_size = table_slice_buffer_.size() - before;
+  } else {
+    uncompressed_buffer_.clear();
+    if (auto error = table_slice_serializer_(y))
+      return error;
+    uncompressed_size = uncompressed_buffer_.size();
+    auto bound = compress_bound(method_, uncompressed_size);
+    table_slice_buffer_.resize(before + bound);
+    auto n = compress(method_, uncompressed_buffer_.data(), uncompressed_size,
+                      table_slice_buffer_.data() + before, bound);
+    table_slice_buffer_.resize(before + n);
+    if (n == 0)
+      return make_error(ec::format_error, "failed to compress table slice");
   }
   auto after = table_slice_buffer_.size();
   VAST_ASSERT(before < after);
-  meta_.slices.push_back({
-    detail::narrow_cast<int64_t>(before),
-    detail::narrow_cast<int64_t>(after),
-    x->offset(), x->rows()});
+  // The buffer begins with room for the header, and the footer index holds
+  // offsets relative to the payload.
+  slices_index_.push_back({
+    x->offset(), x->rows(),
+    before - segment::payload_offset, after - segment::payload_offset,
+    uncompressed_size, uhash<xxhash64>{}(type{x->layout()})});
   min_table_slice_offset_ = x->offset() + x->rows();
   slices_.push_back(x);
   return caf::none;
 }
 
 segment_ptr segment_builder::finish() {
-  if (meta_.slices.empty())
+  if (slices_index_.empty())
     return nullptr;
-  auto result = segment_ptr{new segment, false};
-  result->meta_ = std::move(meta_);
-  result->chunk_ = chunk::make(std::move(table_slice_buffer_));
-  result->header_.magic = segment::magic;
-  result->header_.version = segment::version;
-  result->header_.id = id_;
+  // Assemble the segment in place: fill in the header and the index
+  // descriptor, and append the footer index after aligning it.
+  auto payload_size = table_slice_buffer_.size() - segment::payload_offset;
+  auto alignment = alignof(segment_slice_entry);
+  auto footer_offset = (table_slice_buffer_.size() + alignment - 1)
+                       & ~(alignment - 1);
+  segment_header header{segment::magic, segment::version, id_,
+                        segment::payload_offset};
+  segment_index_descriptor descriptor{footer_offset, slices_index_.size(),
+                                      method_, {}};
+  auto footer_size = slices_index_.size() * sizeof(segment_slice_entry);
+  table_slice_buffer_.resize(footer_offset + footer_size, 0);
+  auto ptr = table_slice_buffer_.data();
+  std::memcpy(ptr, &header, sizeof(header));
+  std::memcpy(ptr + sizeof(header), &descriptor, sizeof(descriptor));
+  std::memcpy(ptr + footer_offset, slices_index_.data(), footer_size);
+  VAST_DEBUG(this, "finished segment", id_, "with", slices_index_.size(),
+             "slices and", payload_size, "bytes of payload");
+  auto result = segment::make(chunk::make(std::move(table_slice_buffer_)));
+  VAST_ASSERT(result != nullptr);
   reset();
   return result;
 }
@@ -83,14 +146,28 @@ const uuid& segment_builder::id() const {
 }
 
 size_t segment_builder::table_slice_bytes() const {
-  return table_slice_buffer_.size();
+  return table_slice_buffer_.size() - segment::payload_offset;
+}
+
+compression segment_builder::compression_method() const {
+  return method_;
+}
+
+bool segment_builder::columnar() const {
+  return columnar_;
+}
+
+bool segment_builder::dictionary_encoding() const {
+  return dictionary_encoding_;
 }
 
 void segment_builder::reset() {
   min_table_slice_offset_ = 0;
-  meta_ = {};
+  slices_index_.clear();
   id_ = uuid::random();
-  table_slice_buffer_ = {};
+  // Reserve room for the header and the index descriptor.
+  table_slice_buffer_.assign(segment::payload_offset, 0);
+  uncompressed_buffer_.clear();
   slices_.clear();
 }
 
@@ -13,9 +13,16 @@
 
 #include "vast/segment_store.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <utility>
+
 #include <caf/config_value.hpp>
 #include <caf/dictionary.hpp>
 #include <caf/settings.hpp>
+#include <caf/stream_deserializer.hpp>
+#include <caf/streambuf.hpp>
 
 #include "vast/bitmap_algorithms.hpp"
 #include "vast/error.hpp"
@@ -27,6 +34,7 @@
 #include "vast/segment_store.hpp"
 
 #include "vast/concept/printable/to_string.hpp"
+#include "vast/concept/printable/vast/compression.hpp"
 #include "vast/concept/printable/vast/error.hpp"
 #include "vast/concept/printable/vast/filesystem.hpp"
 #include "vast/concept/printable/vast/uuid.hpp"
@@ -36,13 +44,20 @@
 
 namespace vast {
 
-segment_store_ptr segment_store::make(path dir, size_t max_segment_size,
-                                      size_t in_memory_segments) {
+segment_store_ptr
+segment_store::make(path dir, size_t max_segment_size,
+                    size_t cache_capacity, compression method,
+                    size_t max_pending_segments, bool columnar,
+                    bool dictionary_encoding) {
   VAST_TRACE(VAST_ARG(dir), VAST_ARG(max_segment_size),
-             VAST_ARG(in_memory_segments));
+             VAST_ARG(cache_capacity), VAST_ARG(max_pending_segments),
+             VAST_ARG(columnar), VAST_ARG(dictionary_encoding));
   VAST_ASSERT(max_segment_size > 0);
+  VAST_ASSERT(max_pending_segments > 0);
   auto x = std::make_unique<segment_store>(std::move(dir), max_segment_size,
-                                           in_memory_segments);
+                                           cache_capacity, method,
+                                           max_pending_segments, columnar,
+                                           dictionary_encoding);
   // Materialize meta data of existing segments.
   if (exists(x->meta_path())) {
     VAST_DEBUG_ANON(__func__, "loads segment meta data from", x->meta_path());
@@ -52,11 +67,27 @@ segment_store_ptr segment_store::make(path dir, size_t max_segment_size,
       return nullptr;
     }
   }
+  if (exists(x->journal_path())) {
+    VAST_DEBUG_ANON(__func__, "replays segment meta data journal",
+                    x->journal_path());
+    if (auto err = x->replay_journal()) {
+      VAST_ERROR_ANON(__func__, "failed to replay meta data journal",
+                      x->journal_path());
+      return nullptr;
+    }
+  }
+  x->persisted_ = x->segments_;
   return x;
 }
 
 segment_store::~segment_store() {
-  // nop
+  // The I/O thread writes all pending segments before it terminates.
+  {
+    std::lock_guard<std::mutex> guard{pending_mutex_};
+    shutdown_ = true;
+  }
+  pending_cv_.notify_all();
+  writer_.join();
 }
 
 caf::error segment_store::put(table_slice_ptr xs) {
@@ -64,46 +95,214 @@ caf::error segment_store::put(table_slice_ptr xs) {
   VAST_DEBUG(this, "adds a table slice");
   if (auto error = builder_.add(xs))
     return error;
-  if (!segments_.inject(xs->offset(), xs->offset() + xs->rows(), builder_.id()))
+  auto first = xs->offset();
+  auto last = xs->offset() + xs->rows();
+  if (!segments_.inject(first, last, builder_.id()))
     return make_error(ec::unspecified, "failed to update range_map");
+  if (!unjournaled_.empty() && unjournaled_.back().last == first)
+    unjournaled_.back().last = last;
+  else
+    unjournaled_.push_back({first, last, builder_.id()});
   if (builder_.table_slice_bytes() < max_segment_size_)
     return caf::none;
   // We have exceeded our maximum segment size and now finish.
-  return flush();
+  return finish_segment();
 }
 
 caf::error segment_store::flush() {
-  if (builder_.table_slice_bytes() == 0)
-    return caf::none; // Nothing to flush.
+  caf::error err;
+  if (builder_.table_slice_bytes() > 0)
+    err = finish_segment();
+  auto pending_err = await_pending();
+  return err ? err : pending_err;
+}
+
+caf::expected<segment_ptr> segment_store::load_segment(uuid id) const {
+  auto filename = segment_path() / to_string(id);
+  VAST_DEBUG(this, "loads segment from", filename);
+  if (auto chk = chunk::mmap(filename)) {
+    if (auto x = segment::make(std::move(chk)))
+      return x;
+    return make_error(ec::format_error, "got invalid segment", filename);
+  }
+  return make_error(ec::filesystem_error, "failed to mmap chunk", filename);
+}
+
+segment_ptr segment_store::resident_segment(const uuid& id) const {
+  if (auto x = cache_.find(id)) {
+    VAST_DEBUG(this, "got cache hit for segment", id);
+    return *x;
+  }
+  std::lock_guard<std::mutex> guard{pending_mutex_};
+  auto pred = [&](const pending_segment& x) { return x.segment->id() == id; };
+  auto i = std::find_if(pending_.begin(), pending_.end(), pred);
+  if (i != pending_.end()) {
+    VAST_DEBUG(this, "got pending segment", id);
+    return i->segment;
+  }
+  return nullptr;
+}
+
+caf::expected<segment_ptr> segment_store::get_segment(const uuid& id) const {
+  if (auto x = resident_segment(id))
+    return x;
+  VAST_DEBUG(this, "got cache miss for segment", id);
+  auto x = load_segment(id);
+  if (!x)
+    return x.error();
+  cache_.emplace(id, *x);
+  return x;
+}
+
+caf::error segment_store::finish_segment() {
   auto x = builder_.finish();
   if (x == nullptr)
     return make_error(ec::unspecified, "failed to build segment");
-  auto filename = segment_path() / to_string(x->id());
-  if (auto err = save(nullptr, filename, x))
-    return err;
   // Keep new segment in the cache.
   cache_.emplace(x->id(), x);
-  VAST_DEBUG(this, "wrote new segment to", filename.trim(-3));
-  VAST_DEBUG(this, "saves segment meta data");
-  return save(nullptr, meta_path(), segments_);
+  std::unique_lock<std::mutex> lock{pending_mutex_};
+  // Apply backpressure when the I/O thread cannot keep up.
+  pending_cv_.wait(lock, [&] {
+    return pending_.size() < max_pending_segments_;
+  });
+  VAST_DEBUG(this, "enqueues segment", x->id(), "with", pending_.size(),
+             "pending segments");
+  pending_.push_back({std::move(x), std::move(unjournaled_),
+                      std::chrono::steady_clock::now()});
+  unjournaled_.clear();
+  // Report a failed write exactly once, so that the store remains usable.
+  auto err = std::exchange(write_error_, caf::none);
+  lock.unlock();
+  pending_cv_.notify_all();
+  return err;
 }
 
-caf::expected<segment_ptr> segment_store::load_segment(uuid id) const {
-  auto filename = segment_path() / to_string(id);
-  VAST_DEBUG(this, "loads segment from", filename);
-  if (auto chk = chunk::mmap(filename))
-    return segment::make(std::move(chk));
-  return make_error(ec::filesystem_error, "failed to mmap chunk", filename);
+caf::error segment_store::await_pending() {
+  std::unique_lock<std::mutex> lock{pending_mutex_};
+  pending_cv_.wait(lock, [&] { return pending_.empty(); });
+  return std::exchange(write_error_, caf::none);
+}
+
+caf::error segment_store::replay_journal() {
+  auto contents = load_contents(journal_path());
+  if (!contents)
+    return contents.error();
+  caf::charbuf buf{contents->data(), contents->size()};
+  caf::stream_deserializer<caf::charbuf&> source{buf};
+  while (buf.in_avail() > 0) {
+    meta_record x;
+    if (source(x)) {
+      // A crash during an append leaves a truncated record behind.
+      VAST_WARNING(this, "ignores truncated record at the end of the journal");
+      break;
+    }
+    ++journal_records_;
+    if (segments_.inject(x.first, x.last, x.segment))
+      continue;
+    // The checkpoint may already contain the record if we crashed between
+    // writing a checkpoint and removing the journal.
+    auto [first, last, segment] = segments_.find(x.first);
+    if (segment == nullptr || *segment != x.segment || first > x.first
+        || last < x.last)
+      return make_error(ec::format_error, "conflicting journal record");
+  }
+  return caf::none;
+}
+
+caf::error
+segment_store::write_journal(const std::vector<meta_record>& records) {
+  for (auto& x : records) {
+    auto injected = persisted_.inject(x.first, x.last, x.segment);
+    VAST_ASSERT(injected);
+    static_cast<void>(injected);
+  }
+  journal_records_ += records.size();
+  // Compact the journal once it holds more records than the checkpoint, which
+  // keeps the amortized cost per segment constant.
+  if (journal_records_ > std::max(persisted_.size(), size_t{1024})) {
+    VAST_DEBUG(this, "compacts", journal_records_, "journal records");
+    if (auto err = save(nullptr, meta_path(), persisted_))
+      return err;
+    if (!rm(journal_path()))
+      return make_error(ec::filesystem_error, "failed to remove journal",
+                        journal_path());
+    journal_records_ = 0;
+    return caf::none;
+  }
+  std::vector<char> buf;
+  for (auto& x : records)
+    if (auto err = save(nullptr, buf, x))
+      return err;
+  std::ofstream fs{journal_path().str(), std::ios::binary | std::ios::app};
+  fs.write(buf.data(), buf.size());
+  fs.flush();
+  if (!fs)
+    return make_error(ec::filesystem_error, "failed to append to journal",
+                      journal_path());
+  return caf::none;
+}
+
+void segment_store::run_writer() {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  std::unique_lock<std::mutex> lock{pending_mutex_};
+  while (true) {
+    pending_cv_.wait(lock, [&] { return shutdown_ || !pending_.empty(); });
+    if (pending_.empty())
+      return;
+    // The segment stays in the queue while we write it, so that lookups can
+    // still find it.
+    auto& front = pending_.front();
+    auto x = front.segment;
+    auto enqueued = front.enqueued;
+    auto records = std::move(front.records);
+    lock.unlock();
+    auto filename = segment_path() / to_string(x->id());
+    auto err = save(nullptr, filename, x);
+    if (!err) {
+      VAST_DEBUG(this, "wrote new segment to", filename.trim(-3));
+      err = write_journal(records);
+    }
+    auto latency = duration_cast<microseconds>(std::chrono::steady_clock::now()
+                                               - enqueued);
+    lock.lock();
+    pending_.pop_front();
+    if (err) {
+      VAST_ERROR(this, "failed to write segment", x->id());
+      // Keep the first error until a caller picks it up. The I/O thread
+      // continues with the next segment.
+      if (!write_error_)
+        write_error_ = std::move(err);
+    } else {
+      ++written_segments_;
+      last_flush_latency_ = latency;
+      max_flush_latency_ = std::max(max_flush_latency_, latency);
+    }
+    pending_cv_.notify_all();
+  }
+}
+
+void segment_store::parallel_extraction(size_t workers,
+                                        size_t max_bytes_in_flight) {
+  VAST_ASSERT(workers > 0);
+  extract_workers_ = workers;
+  max_extract_bytes_ = max_bytes_in_flight;
 }
 
-std::unique_ptr<store::lookup> segment_store::extract(const ids& xs) const {
+std::unique_ptr<store::lookup>
+segment_store::extract(const ids& xs,
+                       const std::vector<size_t>& columns) const {
 
   class lookup : public store::lookup {
   public:
     using uuid_iterator = std::vector<uuid>::iterator;
 
-    lookup(const segment_store& store, ids xs, std::vector<uuid>&& candidates)
-      : store_{store}, xs_{std::move(xs)}, candidates_{std::move(candidates)} {
+    lookup(const segment_store& store, ids xs, std::vector<size_t> columns,
+           std::vector<uuid>&& candidates)
+      : store_{store},
+        xs_{std::move(xs)},
+        columns_{std::move(columns)},
+        candidates_{std::move(candidates)} {
       VAST_ASSERT(!candidates_.empty());
     }
 
@@ -121,42 +320,95 @@ std::unique_ptr<store::lookup> segment_store::extract(const ids& xs) const {
     }
 
   private:
+    /// A candidate segment that is either resident or loading in the
+    /// background.
+    struct slot {
+      uuid id;
+      segment_ptr segment;
+      std::future<caf::expected<segment_ptr>> loading;
+    };
+
+    /// Extends the window of candidates until either all workers are busy or
+    /// the segments in flight would exceed the byte budget. Resident segments
+    /// enter the window without occupying a worker.
+    void schedule() {
+      auto fits = [&] {
+        if (loading_ == 0)
+          return true;
+        auto in_flight = (loading_ + 1) * store_.max_segment_size_;
+        return loading_ < store_.extract_workers_
+               && in_flight <= store_.max_extract_bytes_;
+      };
+      while (first_ != candidates_.end() && fits()) {
+        auto& cand = *first_++;
+        slot x{cand, nullptr, {}};
+        if (cand != store_.builder_.id()) {
+          x.segment = store_.resident_segment(cand);
+          if (x.segment == nullptr) {
+            VAST_DEBUG(this, "loads segment", cand, "in the background");
+            auto& store = store_;
+            x.loading = std::async(std::launch::async, [&store, cand] {
+              return store.load_segment(cand);
+            });
+            ++loading_;
+          }
+        }
+        window_.push_back(std::move(x));
+      }
+    }
+
     caf::expected<std::vector<table_slice_ptr>> handle_segment() {
-      if (first_ == candidates_.end())
+      schedule();
+      if (window_.empty())
         return caf::no_error;
-      auto& cand = *first_++;
-      if (cand == store_.builder_.id()) {
-        VAST_DEBUG(this, "looks into the active segement", cand);
-        return store_.builder_.lookup(xs_);
+      auto x = std::move(window_.front());
+      window_.pop_front();
+      if (x.id == store_.builder_.id()) {
+        VAST_DEBUG(this, "looks into the active segement", x.id);
+        return project(store_.builder_.lookup(xs_));
       }
-      segment_ptr seg_ptr = nullptr;
-      auto i = store_.cache_.find(cand);
-      if (i != store_.cache_.end()) {
-        VAST_DEBUG(this, "got cache hit for segment", cand);
-        seg_ptr = i->second;
-      } else {
-        VAST_DEBUG(this, "got cache miss for segment", cand);
-        if(auto seg_ptr_ = store_.load_segment(cand))
-          seg_ptr = *seg_ptr_;
-        else
-          return seg_ptr_.error();
-        i = store_.cache_.emplace(cand, seg_ptr).first;
+      if (x.loading.valid()) {
+        auto seg_ptr = x.loading.get();
+        --loading_;
+        if (!seg_ptr)
+          return seg_ptr.error();
+        x.segment = std::move(*seg_ptr);
+        store_.cache_.emplace(x.id, x.segment);
       }
-      VAST_ASSERT(seg_ptr != nullptr);
-      return seg_ptr->lookup(xs_);
+      VAST_ASSERT(x.segment != nullptr);
+      // Keep the workers busy while the caller consumes this segment.
+      schedule();
+      return project(x.segment->lookup(xs_));
+    }
+
+    /// Restricts the table slices of a segment to the requested columns.
+    caf::expected<std::vector<table_slice_ptr>>
+    project(caf::expected<std::vector<table_slice_ptr>> xs) const {
+      if (!xs || columns_.empty())
+        return xs;
+      std::vector<table_slice_ptr> result;
+      result.reserve(xs->size());
+      for (auto& x : *xs)
+        if (auto y = vast::project(x, columns_))
+          result.push_back(std::move(y));
+      return result;
     }
 
     const segment_store& store_;
     ids xs_;
+    std::vector<size_t> columns_;
     std::vector<uuid> candidates_;
     uuid_iterator first_ = candidates_.begin();
+    std::deque<slot> window_;
+    size_t loading_ = 0;
     caf::expected<std::vector<table_slice_ptr>> buffer_{caf::no_error};
     std::vector<table_slice_ptr>::iterator it_;
   };
 
   VAST_TRACE(VAST_ARG(xs));
   // Collect candidate segments by seeking through the ID set and
-  // probing each ID interval.
+  // probing each ID interval. The candidates are in ID order, which the
+  // lookup preserves when emitting table slices.
   VAST_DEBUG(this, "retrieves table slices with requested ids");
   std::vector<uuid> candidates;
   auto f = [](auto x) { return std::pair{x.left, x.right}; };
@@ -170,10 +422,8 @@ std::unique_ptr<store::lookup> segment_store::extract(const ids& xs) const {
   auto end = segments_.end();
   select_with(xs, begin, end, f, g);
   VAST_DEBUG(this, "processes", candidates.size(), "candidates");
-  std::partition(candidates.begin(), candidates.end(), [&](const auto& id) {
-    return id == builder_.id() || cache_.find(id) != cache_.end();
-  });
-  return std::make_unique<lookup>(*this, std::move(xs), std::move(candidates));
+  return std::make_unique<lookup>(*this, std::move(xs), columns,
+                                  std::move(candidates));
 }
 
 caf::expected<std::vector<table_slice_ptr>>
@@ -198,7 +448,7 @@ segment_store::get(const ids& xs) {
   std::vector<table_slice_ptr> result;
   VAST_DEBUG(this, "processes", candidates.size(), "candidates");
   std::partition(candidates.begin(), candidates.end(), [&](const auto& id) {
-    return id == builder_.id() || cache_.find(id) != cache_.end();
+    return id == builder_.id() || cache_.contains(id);
   });
   for (auto cand = candidates.begin(); cand != candidates.end(); ++cand) {
     auto& id = *cand;
@@ -207,21 +457,12 @@ segment_store::get(const ids& xs) {
       VAST_DEBUG(this, "looks into the active segement", id);
       slices = builder_.lookup(xs);
     } else {
-      segment_ptr seg_ptr = nullptr;
-      auto i = cache_.find(id);
-      if (i != cache_.end()) {
-        VAST_DEBUG(this, "got cache hit for segment", id);
-        seg_ptr = i->second;
-      } else {
-        VAST_DEBUG(this, "got cache miss for segment", id);
-        auto x = load_segment(id);
-        if (!x)
-          return x.error();
-        i = cache_.emplace(id, std::move(*x)).first;
-      }
-      VAST_ASSERT(seg_ptr != nullptr);
+      auto seg_ptr = get_segment(id);
+      if (!seg_ptr)
+        return seg_ptr.error();
+      VAST_ASSERT(*seg_ptr != nullptr);
       VAST_DEBUG(this, "looks into segment", id);
-      slices = seg_ptr->lookup(xs);
+      slices = (*seg_ptr)->lookup(xs);
     }
     if (!slices)
       return slices.error();
@@ -234,8 +475,12 @@ segment_store::get(const ids& xs) {
 void segment_store::inspect_status(caf::settings& dict) {
   using caf::put;
   put(dict, "meta-path", meta_path().str());
+  put(dict, "journal-path", journal_path().str());
   put(dict, "segment-path", segment_path().str());
   put(dict, "max-segment-size", max_segment_size_);
+  put(dict, "compression", to_string(builder_.compression_method()));
+  put(dict, "columnar", builder_.columnar());
+  put(dict, "dictionary-encoding", builder_.dictionary_encoding());
   auto& segments = put_dictionary(dict, "segments");
   // Note: `for (auto& kvp : segments_)` does not compile.
   for (auto i = segments_.begin(); i != segments_.end(); ++i) {
@@ -247,19 +492,43 @@ void segment_store::inspect_status(caf::settings& dict) {
     put(segments, range, to_string(i->value));
   }
   auto& cached = put_list(dict, "cached");
-  for (auto& kvp : cache_)
+  cache_.for_each([&](auto& kvp) {
     cached.emplace_back(to_string(kvp.first));
+  });
+  auto& cache = put_dictionary(dict, "cache");
+  put(cache, "capacity", cache_.capacity());
+  put(cache, "size", cache_.weight());
+  put(cache, "hits", cache_.statistics().hits);
+  put(cache, "misses", cache_.statistics().misses);
+  put(cache, "evictions", cache_.statistics().evictions);
   auto& current = put_dictionary(dict, "current-segment");
   put(current, "id", to_string(builder_.id()));
   put(current, "size", builder_.table_slice_bytes());
+  std::lock_guard<std::mutex> guard{pending_mutex_};
+  auto& flushing = put_dictionary(dict, "flush");
+  put(flushing, "pending-segments", pending_.size());
+  put(flushing, "max-pending-segments", max_pending_segments_);
+  put(flushing, "written-segments", written_segments_);
+  put(flushing, "last-latency-us", last_flush_latency_.count());
+  put(flushing, "max-latency-us", max_flush_latency_.count());
+}
+
+size_t segment_store::segment_weigher::operator()(const segment_ptr& x) const {
+  return x->chunk()->size();
 }
 
 segment_store::segment_store(path dir, uint64_t max_segment_size,
-                             size_t in_memory_segments)
+                             size_t cache_capacity, compression method,
+                             size_t max_pending_segments, bool columnar,
+                             bool dictionary_encoding)
   : dir_{std::move(dir)},
     max_segment_size_{max_segment_size},
-    cache_{in_memory_segments} {
-  // nop
+    cache_{cache_capacity},
+    builder_{method, columnar, dictionary_encoding},
+    extract_workers_{defaults::system::extract_workers},
+    max_extract_bytes_{defaults::system::max_extract_bytes},
+    max_pending_segments_{max_pending_segments} {
+  writer_ = std::thread{[this] { run_writer(); }};
 }
 
 } // namespace vast
@@ -21,6 +21,7 @@
 #include "vast/defaults.hpp"
 #include "vast/event.hpp"
 #include "vast/expected.hpp"
+#include "vast/ids.hpp"
 #include "vast/logger.hpp"
 #include "vast/segment_store.hpp"
 #include "vast/store.hpp"
@@ -50,14 +51,18 @@ void archive_state::send_report() {
 
 archive_type::behavior_type
 archive(archive_type::stateful_pointer<archive_state> self, path dir,
-        size_t capacity, size_t max_segment_size) {
+        size_t capacity, size_t max_segment_size, compression method,
+        bool columnar, bool dictionary_encoding) {
   // TODO: make the choice of store configurable. For most flexibility, it
   // probably makes sense to pass a unique_ptr<stor> directory to the spawn
   // arguments of the actor. This way, users can provide their own store
   // implementation conveniently.
-  VAST_INFO(self, "spawned:", VAST_ARG(capacity), VAST_ARG(max_segment_size));
+  VAST_INFO(self, "spawned:", VAST_ARG(capacity), VAST_ARG(max_segment_size),
+            VAST_ARG(columnar), VAST_ARG(dictionary_encoding));
   self->state.self = self;
-  self->state.store = segment_store::make(dir, max_segment_size, capacity);
+  self->state.store = segment_store::make(
+    dir, max_segment_size, capacity * max_segment_size, method,
+    defaults::system::max_pending_segments, columnar, dictionary_encoding);
   VAST_ASSERT(self->state.store != nullptr);
   self->set_exit_handler([=](const exit_msg& msg) {
     self->state.send_report();
@@ -86,8 +91,8 @@ archive(archive_type::stateful_pointer<archive_state> self, path dir,
               VAST_DEBUG(self, "dismisses query for inactive sender");
               return make_error(ec::no_error);
             }
-            std::vector<event> result;
             auto session = self->state.store->extract(xs);
+            std::vector<table_slice_ptr> selected;
             while (true) {
               auto slice = session->next();
               if (!slice) {
@@ -96,10 +101,15 @@ archive(archive_type::stateful_pointer<archive_state> self, path dir,
                 // ... or an error occured.
                 return {done_atom::value, std::move(slice.error())};
               }
+              // Ship only the requested rows to the exporter.
               using receiver_type = caf::typed_actor<
                 caf::reacts_to<table_slice_ptr>>;
-              self->send(caf::actor_cast<receiver_type>(self->current_sender()),
-                         *slice);
+              auto receiver = caf::actor_cast<receiver_type>(
+                self->current_sender());
+              selected.clear();
+              select(selected, *slice, xs);
+              for (auto& x : selected)
+                self->send(receiver, std::move(x));
             }
             return {done_atom::value, make_error(ec::no_error)};
           },
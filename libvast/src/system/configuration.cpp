@@ -65,7 +65,11 @@ configuration::configuration() {
 #endif
   opt_group{custom_options_, "vast"}
   .add<size_t>("table-slice-size",
-               "Maximum size for sources that generate table slices.");
+               "Number of rows per table slice with which sources start.")
+  .add<size_t>("table-slice-max-size",
+               "Maximum number of rows per table slice at sources.")
+  .add<caf::timespan>("table-slice-deadline",
+                      "Time within which sources aim to fill a table slice.");
 
   initialize_factories<synopsis, table_slice, table_slice_builder,
                        value_index>();
@@ -13,11 +13,18 @@
 
 #include "vast/system/evaluator.hpp"
 
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include <caf/actor.hpp>
 #include <caf/behavior.hpp>
 #include <caf/event_based_actor.hpp>
 #include <caf/stateful_actor.hpp>
 
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/expression_visitors.hpp"
 #include "vast/logger.hpp"
 #include "vast/system/atoms.hpp"
@@ -26,50 +33,77 @@ namespace vast::system {
 
 namespace {
 
-/// Concatenates IDs according to given predicates. In paticular, resolves
-/// conjunctions, disjunctions, and negations.
-class ids_evaluator {
+using node_kind = evaluator_node::kind;
+
+/// Flattens an expression into the nodes of an evaluator. Computes the same
+/// positions for predicates as `resolve`.
+class node_builder {
 public:
-  ids_evaluator(const evaluator_state::predicate_hits_map& xs) : hits_(xs) {
+  node_builder(evaluator_state& st) : st_(st) {
     push();
   }
 
-  ids operator()(caf::none_t) {
-    return {};
+  size_t operator()(caf::none_t) {
+    auto result = add(node_kind::none);
+    complete(result);
+    return result;
   }
 
   template <class Connective>
-  ids operator()(const Connective& xs) {
+  size_t operator()(const Connective& xs) {
     VAST_ASSERT(xs.size() > 0);
+    auto op = std::is_same_v<Connective, conjunction> ? node_kind::conjunction
+                                                      : node_kind::disjunction;
+    auto result = add(op);
     push();
-    auto result = caf::visit(*this, xs[0]);
-    for (size_t index = 1; index < xs.size(); ++index) {
-      next();
-      if constexpr (std::is_same_v<Connective, conjunction>) {
-        result &= caf::visit(*this, xs[index]);
-      } else {
-        static_assert(std::is_same_v<Connective, disjunction>);
-        result |= caf::visit(*this, xs[index]);
-      }
+    for (size_t index = 0; index < xs.size(); ++index) {
+      if (index > 0)
+        next();
+      adopt(result, caf::visit(*this, xs[index]));
     }
     pop();
     return result;
   }
 
-  ids operator()(const negation& n) {
+  size_t operator()(const negation& n) {
+    auto result = add(node_kind::negation);
     push();
-    auto result = caf::visit(*this, n.expr());
+    adopt(result, caf::visit(*this, n.expr()));
     pop();
-    result.flip();
     return result;
   }
 
-  ids operator()(const predicate&) {
-    auto i = hits_.find(position_);
-    return i != hits_.end() ? i->second.second : ids{};
+  size_t operator()(const predicate&) {
+    auto result = add(node_kind::predicate);
+    st_.predicate_nodes.emplace(position_, result);
+    // No INDEXER reports hits for this predicate.
+    if (st_.hits_for(position_) == nullptr)
+      complete(result);
+    return result;
   }
 
 private:
+  size_t add(node_kind op) {
+    auto index = st_.nodes.size();
+    // Leaves wait for the result of their predicate, connectives for their
+    // operands.
+    auto leaf = op == node_kind::none || op == node_kind::predicate;
+    st_.nodes.push_back({op, index, {}, leaf ? 1u : 0u, {}});
+    return index;
+  }
+
+  // Gives a leaf final hits without any 1-bit.
+  void complete(size_t leaf) {
+    st_.nodes[leaf].pending = 0;
+    st_.nodes[leaf].complete = true;
+  }
+
+  void adopt(size_t parent, size_t child) {
+    st_.nodes[child].parent = parent;
+    st_.nodes[parent].children.push_back(child);
+    ++st_.nodes[parent].pending;
+  }
+
   void push() {
     position_.emplace_back(0);
   }
@@ -83,10 +117,62 @@ private:
     ++position_.back();
   }
 
-  const evaluator_state::predicate_hits_map& hits_;
+  evaluator_state& st_;
   offset position_;
 };
 
+/// Updates a node after the hits of one of its operands changed or became
+/// final. Returns whether the hits of the node changed and whether they
+/// became final.
+std::pair<bool, bool> update(std::vector<evaluator_node>& nodes, size_t index,
+                             size_t child, bool changed, bool completed) {
+  auto& x = nodes[index];
+  auto& y = nodes[child];
+  if (x.complete)
+    return {false, false};
+  if (completed)
+    --x.pending;
+  switch (x.op) {
+    default:
+      return {false, false};
+    case node_kind::conjunction: {
+      if (completed && !any<1>(y.hits)) {
+        // An operand without hits determines the result, so we neither wait
+        // for the remaining operands nor evaluate the conjunction.
+        auto size = ids::size_type{0};
+        for (auto i : x.children)
+          size = std::max(size, nodes[i].hits.size());
+        x.hits = ids{size, false};
+        x.complete = true;
+        return {false, true};
+      }
+      // Otherwise, conjunctions are evaluated once, after all operands
+      // arrived.
+      if (x.pending > 0)
+        return {false, false};
+      std::vector<bitmap_operand<ids>> xs;
+      xs.reserve(x.children.size());
+      for (auto i : x.children)
+        xs.push_back({&nodes[i].hits, detail::block_operation::and_op});
+      x.hits = fold_eval(xs);
+      x.complete = true;
+      return {true, true};
+    }
+    case node_kind::disjunction:
+      // The hits of disjunctions only grow.
+      if (changed)
+        x.hits |= y.hits;
+      x.complete = x.pending == 0;
+      return {changed, x.complete};
+    case node_kind::negation:
+      if (!completed)
+        return {false, false};
+      x.hits = ~y.hits;
+      x.complete = true;
+      return {true, true};
+  }
+}
+
 } // namespace
 
 evaluator_state::evaluator_state(caf::event_based_actor* self) : self(self) {
@@ -99,6 +185,11 @@ void evaluator_state::init(caf::actor client, expression expr,
   this->client = std::move(client);
   this->expr = std::move(expr);
   this->promise = std::move(promise);
+  caf::visit(node_builder{*this}, this->expr);
+  // Leaves without INDEXER actors are final already.
+  for (size_t i = 0; i < nodes.size(); ++i)
+    if (nodes[i].children.empty() && nodes[i].complete)
+      propagate(i);
 }
 
 void evaluator_state::handle_result(const offset& position, const ids& result) {
@@ -110,7 +201,7 @@ void evaluator_state::handle_result(const offset& position, const ids& result) {
   accumulated_hits |= result;
   if (--missing == 0) {
     VAST_DEBUG(self, "collected all INDEXER results at position", position);
-    evaluate();
+    evaluate(position);
   }
   decrement_pending();
 }
@@ -124,15 +215,37 @@ void evaluator_state::handle_missing_result(const offset& position,
   VAST_ASSERT(ptr != nullptr);
   if (--ptr->first == 0) {
     VAST_DEBUG(self, "collected all INDEXER results at position", position);
-    evaluate();
+    evaluate(position);
   }
   decrement_pending();
 }
 
-void evaluator_state::evaluate() {
-  VAST_DEBUG(self, "got predicate_hits:", predicate_hits,
-             "expr_hits:", caf::visit(ids_evaluator{predicate_hits}, expr));
-  auto delta = caf::visit(ids_evaluator{predicate_hits}, expr) - hits;
+void evaluator_state::evaluate(const offset& position) {
+  auto i = predicate_nodes.find(position);
+  VAST_ASSERT(i != predicate_nodes.end());
+  auto index = i->second;
+  nodes[index].pending = 0;
+  nodes[index].complete = true;
+  nodes[index].hits = std::move(hits_for(position)->second);
+  VAST_DEBUG(self, "got final hits", nodes[index].hits,
+             "for predicate at position", position);
+  propagate(index);
+}
+
+void evaluator_state::propagate(size_t index) {
+  // Walk up the tree until a node remains unchanged.
+  auto changed = true;
+  auto completed = true;
+  while (index != 0 && (changed || completed)) {
+    auto child = index;
+    index = nodes[index].parent;
+    std::tie(changed, completed) = update(nodes, index, child, changed,
+                                          completed);
+  }
+  if (index != 0 || !changed)
+    return;
+  VAST_DEBUG(self, "got expr_hits:", nodes[0].hits);
+  auto delta = nodes[0].hits - hits;
   if (any<1>(delta)) {
     hits |= delta;
     self->send(client, std::move(delta));
@@ -161,7 +274,6 @@ caf::behavior evaluator(caf::stateful_actor<evaluator_state>* self,
   using std::move;
   return {[=, expr{move(expr)}, eval{move(eval)}](caf::actor client) {
     auto& st = self->state;
-    st.init(client, move(expr), self->make_response_promise());
     for (auto& [layout, triples] : eval) {
       st.pending_responses += triples.size();
       for (auto& triple : triples) {
@@ -174,6 +286,9 @@ caf::behavior evaluator(caf::stateful_actor<evaluator_state>* self,
                 });
       }
     }
+    // Building the expression tree requires knowing which predicates have
+    // INDEXER actors.
+    st.init(client, move(expr), self->make_response_promise());
     if (st.pending_responses == 0) {
       VAST_DEBUG(self, "has nothing to evaluate for expression");
       st.promise.deliver(done_atom::value);
@@ -225,7 +225,7 @@ public:
     uint64_t events = 0;
     for (auto& x : xs) {
       events += x->rows();
-      x.unshared().offset(st.next_id_block());
+      x = rebase(std::move(x), st.next_id_block());
       out.push(std::move(x));
     }
     t.stop(events);
@@ -345,8 +345,13 @@ void node_state::init(std::string init_name, path init_dir) {
   auto sp = cmd.add(nullptr, "spawn", "creates a new component", opts());
   sp->add(spawn_command, "archive", "creates a new archive",
           opts()
-            .add<size_t>("segments,s", "number of cached segments")
-            .add<size_t>("max-segment-size,m", "maximum segment size in MB"));
+            .add<size_t>("segments,s", "segment cache size in maximum segments")
+            .add<size_t>("max-segment-size,m", "maximum segment size in MB")
+            .add<caf::atom_value>("compression,c",
+                                  "segment compression (null, lz4, snappy)")
+            .add<bool>("columnar", "store table slices column by column")
+            .add<bool>("dictionary",
+                       "dictionary-encode low-cardinality string columns"));
   sp->add(spawn_command, "exporter", "creates a new exporter",
           opts()
             .add<bool>("continuous,c", "marks a query as continuous")
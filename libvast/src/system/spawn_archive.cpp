@@ -20,7 +20,9 @@
 #include <caf/local_actor.hpp>
 #include <caf/settings.hpp>
 
+#include "vast/compression.hpp"
 #include "vast/defaults.hpp"
+#include "vast/error.hpp"
 #include "vast/filesystem.hpp"
 #include "vast/si_literals.hpp"
 #include "vast/system/archive.hpp"
@@ -37,7 +39,27 @@ maybe_actor spawn_archive(caf::local_actor* self, spawn_arguments& args) {
   auto segments = get_or(args.options, "segments", sd::segments);
   auto mss = 1_MiB
              * get_or(args.options, "max-segment-size", sd::max_segment_size);
-  auto a = self->spawn(archive, args.dir / args.label, segments, mss);
+  auto method = compression::null;
+  switch (get_or(args.options, "compression", sd::segment_compression)) {
+    default:
+      return make_error(ec::invalid_configuration,
+                        "unsupported segment compression method");
+    case caf::atom("null"):
+      break;
+    case caf::atom("lz4"):
+      method = compression::lz4;
+      break;
+#ifdef VAST_HAVE_SNAPPY
+    case caf::atom("snappy"):
+      method = compression::snappy;
+      break;
+#endif
+  }
+  auto columnar = get_or(args.options, "columnar", sd::columnar_segments);
+  auto dictionary = get_or(args.options, "dictionary",
+                           sd::dictionary_encoding);
+  auto a = self->spawn(archive, args.dir / args.label, segments, mss, method,
+                       columnar, dictionary);
   return caf::actor_cast<caf::actor>(a);
 }
 
@@ -30,10 +30,12 @@ maybe_actor spawn_importer(node_actor* self, spawn_arguments& args) {
   if (!args.empty())
     return unexpected_arguments(args);
   // FIXME: Notify exporters with a continuous query.
+  // Each slice gets a block of IDs, which must hold the largest slice that
+  // sources produce.
   return self->spawn(importer, args.dir / args.label,
                      caf::get_or(self->system().config(),
-                                 "vast.table-slice-size",
-                                 defaults::system::table_slice_size));
+                                 "vast.table-slice-max-size",
+                                 defaults::system::table_slice_max_size));
 }
 
 } // namespace vast::system
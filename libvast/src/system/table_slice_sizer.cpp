@@ -0,0 +1,56 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/system/table_slice_sizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace vast::system {
+
+namespace {
+
+double seconds(timespan x) {
+  return std::chrono::duration_cast<std::chrono::duration<double>>(x).count();
+}
+
+} // namespace <anonymous>
+
+table_slice_sizer::table_slice_sizer(size_t size, size_t max_size,
+                                     timespan deadline)
+  : max_size_{std::max(max_size, size_t{1})},
+    deadline_{deadline},
+    size_{std::clamp(size, size_t{1}, max_size_)} {
+  // nop
+}
+
+size_t table_slice_sizer::batch_size(size_t num) const noexcept {
+  if (num == 0 || !sampled_)
+    return num * size_;
+  auto slices = std::floor(rate_ * seconds(deadline_) / size_);
+  auto n = static_cast<size_t>(std::clamp(slices, 1.0, double(num)));
+  return n * size_;
+}
+
+void table_slice_sizer::update(size_t events, timespan elapsed) {
+  if (deadline_ <= timespan::zero() || elapsed <= timespan::zero())
+    return;
+  auto sample = events / seconds(elapsed);
+  rate_ = sampled_ ? smoothing * sample + (1 - smoothing) * rate_ : sample;
+  sampled_ = true;
+  auto rows = std::ceil(rate_ * seconds(deadline_));
+  size_ = static_cast<size_t>(std::clamp(rows, 1.0, double(max_size_)));
+}
+
+} // namespace vast::system
@@ -13,6 +13,7 @@
 
 #include "vast/table_slice.hpp"
 
+#include <numeric>
 #include <unordered_map>
 
 #include <caf/actor_system.hpp>
@@ -26,6 +27,7 @@
 #include <caf/stream_deserializer.hpp>
 #include <caf/sum_type.hpp>
 
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/chunk.hpp"
 #include "vast/default_table_slice.hpp"
 #include "vast/default_table_slice_builder.hpp"
@@ -37,7 +39,9 @@
 #include "vast/event.hpp"
 #include "vast/factory.hpp"
 #include "vast/format/test.hpp"
+#include "vast/ids.hpp"
 #include "vast/logger.hpp"
+#include "vast/table_slice_builder_factory.hpp"
 #include "vast/table_slice_factory.hpp"
 #include "vast/value.hpp"
 #include "vast/value_index.hpp"
@@ -52,6 +56,120 @@ auto cap (size_type pos, size_type num, size_type last) {
   return num == table_slice::npos ? last : std::min(last, pos + num);
 }
 
+/// A table slice with its own header that shares the cells of another slice.
+/// The handle covers a contiguous range of rows and, optionally, a subset of
+/// the columns of the shared slice. Serialization writes the cells in the
+/// format of the shared slice, so that readers reconstruct a slice of the
+/// original type. Only handles that cover a part of the shared slice copy
+/// their cells for that purpose.
+class shared_table_slice final : public table_slice {
+public:
+  /// Creates a handle for some rows and columns of *xs*.
+  /// @param xs The slice to share.
+  /// @param offset The offset of the handle.
+  /// @param first_row The first row of *xs* to include.
+  /// @param num_rows The number of rows to include.
+  /// @param columns The columns of *xs* to include in increasing order. An
+  ///        empty list includes all columns.
+  static table_slice_ptr make(const table_slice_ptr& xs, id offset,
+                              size_type first_row, size_type num_rows,
+                              std::vector<size_type> columns) {
+    VAST_ASSERT(first_row + num_rows <= xs->rows());
+    auto body = xs;
+    // Avoid chains of handles by referring to the innermost slice.
+    if (auto y = dynamic_cast<const shared_table_slice*>(xs.get())) {
+      first_row += y->first_row_;
+      for (auto& col : columns)
+        col = y->body_column(col);
+      if (columns.empty())
+        columns = y->columns_;
+      body = y->body_;
+    }
+    table_slice_header header;
+    header.layout = body->layout();
+    if (!columns.empty()) {
+      header.layout.fields.clear();
+      for (auto col : columns)
+        header.layout.fields.push_back(body->layout().fields[col]);
+    }
+    header.rows = num_rows;
+    header.offset = offset;
+    auto ptr = new shared_table_slice{std::move(header), std::move(body),
+                                      first_row, std::move(columns)};
+    return table_slice_ptr{ptr, false};
+  }
+
+  shared_table_slice* copy() const override {
+    return new shared_table_slice(*this);
+  }
+
+  caf::error serialize(caf::serializer& sink) const override {
+    if (covers_body())
+      return body_->serialize(sink);
+    std::vector<size_type> all(columns());
+    std::iota(all.begin(), all.end(), size_type{0});
+    auto x = project(all);
+    VAST_ASSERT(x->implementation_id() == implementation_id());
+    return x->serialize(sink);
+  }
+
+  caf::error deserialize(caf::deserializer&) override {
+    // The factory never creates this type.
+    return make_error(ec::unspecified, "cannot deserialize a shared slice");
+  }
+
+  data_view at(size_type row, size_type col) const override {
+    VAST_ASSERT(row < rows());
+    VAST_ASSERT(col < columns());
+    return body_->at(first_row_ + row, body_column(col));
+  }
+
+  caf::atom_value implementation_id() const noexcept override {
+    // Copies of the visible cells fall back to the default implementation
+    // when the shared slice has no builder.
+    auto id = body_->implementation_id();
+    if (covers_body() || factory<table_slice_builder>::get(id) != nullptr)
+      return id;
+    return default_table_slice::class_id;
+  }
+
+  table_slice_ptr
+  project(const std::vector<size_type>& columns) const override {
+    if (first_row_ != 0 || rows() != body_->rows())
+      return table_slice::project(columns);
+    // Let the shared slice copy its columns, which may avoid decoding cells.
+    std::vector<size_type> body_columns;
+    body_columns.reserve(columns.size());
+    for (auto col : columns)
+      body_columns.push_back(body_column(col));
+    auto result = body_->project(body_columns);
+    result.unshared().offset(offset());
+    return result;
+  }
+
+private:
+  shared_table_slice(table_slice_header header, table_slice_ptr body,
+                     size_type first_row, std::vector<size_type> columns)
+    : table_slice{std::move(header)},
+      body_{std::move(body)},
+      first_row_{first_row},
+      columns_{std::move(columns)} {
+    // nop
+  }
+
+  size_type body_column(size_type col) const noexcept {
+    return columns_.empty() ? col : columns_[col];
+  }
+
+  bool covers_body() const noexcept {
+    return first_row_ == 0 && rows() == body_->rows() && columns_.empty();
+  }
+
+  table_slice_ptr body_;
+  size_type first_row_;
+  std::vector<size_type> columns_;
+};
+
 } // namespace <anonymous>
 
 table_slice::table_slice(table_slice_header header)
@@ -82,10 +200,36 @@ caf::error table_slice::load(chunk_ptr chunk) {
   return deserialize(source);
 }
 
+table_slice_ptr
+table_slice::project(const std::vector<size_type>& columns) const {
+  VAST_ASSERT(!columns.empty() && columns.back() < this->columns());
+  auto projected = layout();
+  projected.fields.clear();
+  for (auto col : columns)
+    projected.fields.push_back(layout().fields[col]);
+  auto builder = factory<table_slice_builder>::make(implementation_id(),
+                                                    projected);
+  if (builder == nullptr)
+    builder = default_table_slice_builder::make(projected);
+  for (size_type row = 0; row < rows(); ++row)
+    for (auto col : columns) {
+      auto added = builder->add(at(row, col));
+      VAST_ASSERT(added);
+      static_cast<void>(added);
+    }
+  auto result = builder->finish();
+  VAST_ASSERT(result != nullptr);
+  result.unshared().offset(offset());
+  return result;
+}
+
 void table_slice::append_column_to_index(size_type col,
                                          value_index& idx) const {
+  std::vector<data_view> xs;
+  xs.reserve(rows());
   for (size_type row = 0; row < rows(); ++row)
-    idx.append(at(row, col), offset() + row);
+    xs.push_back(at(row, col));
+  idx.append(column_batch{std::move(xs)}, offset());
 }
 
 expected<std::vector<table_slice_ptr>>
@@ -112,6 +256,68 @@ make_random_table_slices(size_t num_slices, size_t slice_size,
   return result;
 }
 
+void select(std::vector<table_slice_ptr>& result, const table_slice_ptr& xs,
+            const ids& selection) {
+  VAST_ASSERT(xs != nullptr);
+  auto first = xs->offset();
+  auto last = xs->offset() + xs->rows();
+  // Collect the contiguous runs of selected IDs in [first, last).
+  std::vector<std::pair<id, id>> runs;
+  auto rng = select(selection);
+  if (rng && rng.get() < first)
+    rng.next_from(first);
+  for (; rng && rng.get() < last; rng.next()) {
+    auto i = rng.get();
+    if (runs.empty() || runs.back().second != i)
+      runs.emplace_back(i, i + 1);
+    else
+      ++runs.back().second;
+  }
+  if (runs.empty())
+    return;
+  if (runs.size() == 1 && runs[0].first == first && runs[0].second == last) {
+    result.emplace_back(xs);
+    return;
+  }
+  for (auto [run_first, run_last] : runs)
+    result.emplace_back(shared_table_slice::make(xs, run_first,
+                                                 run_first - first,
+                                                 run_last - run_first, {}));
+}
+
+std::vector<table_slice_ptr> select(const table_slice_ptr& xs,
+                                    const ids& selection) {
+  std::vector<table_slice_ptr> result;
+  select(result, xs, selection);
+  return result;
+}
+
+table_slice_ptr project(const table_slice_ptr& xs,
+                        const std::vector<size_t>& columns) {
+  VAST_ASSERT(xs != nullptr);
+  if (columns.empty())
+    return xs;
+  std::vector<table_slice::size_type> selected;
+  for (auto col : columns)
+    if (col < xs->columns())
+      selected.push_back(col);
+  if (selected.empty())
+    return nullptr;
+  if (selected.size() == xs->columns())
+    return xs;
+  return shared_table_slice::make(xs, xs->offset(), 0, xs->rows(),
+                                  std::move(selected));
+}
+
+table_slice_ptr rebase(table_slice_ptr xs, id offset) {
+  VAST_ASSERT(xs != nullptr);
+  if (xs->unique()) {
+    xs.unshared().offset(offset);
+    return xs;
+  }
+  return shared_table_slice::make(xs, offset, 0, xs->rows(), {});
+}
+
 void intrusive_ptr_add_ref(const table_slice* ptr) {
   intrusive_ptr_add_ref(static_cast<const caf::ref_counted*>(ptr));
 }
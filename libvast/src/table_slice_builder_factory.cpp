@@ -13,14 +13,20 @@
 
 #include "vast/table_slice_builder_factory.hpp"
 
+#include "vast/columnar_table_slice.hpp"
+#include "vast/columnar_table_slice_builder.hpp"
 #include "vast/default_table_slice.hpp"
 #include "vast/default_table_slice_builder.hpp"
+#include "vast/packed_table_slice.hpp"
+#include "vast/packed_table_slice_builder.hpp"
 
 namespace vast {
 
 void factory_traits<table_slice_builder>::initialize() {
   using f = factory<table_slice_builder>;
   f::add<default_table_slice_builder>(default_table_slice::class_id);
+  f::add<packed_table_slice_builder>(packed_table_slice::class_id);
+  f::add<columnar_table_slice_builder>(columnar_table_slice::class_id);
 }
 
 } // namespace vast
@@ -17,14 +17,18 @@
 #include <caf/stream_deserializer.hpp>
 
 #include "vast/chunk.hpp"
+#include "vast/columnar_table_slice.hpp"
 #include "vast/default_table_slice.hpp"
 #include "vast/detail/assert.hpp"
 #include "vast/logger.hpp"
+#include "vast/packed_table_slice.hpp"
 
 namespace vast {
 
 void factory_traits<table_slice>::initialize() {
   factory<table_slice>::add<default_table_slice>();
+  factory<table_slice>::add<packed_table_slice>();
+  factory<table_slice>::add<columnar_table_slice>();
 }
 
 table_slice_ptr factory_traits<table_slice>::make(chunk_ptr chunk) {
@@ -11,13 +11,57 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <algorithm>
 #include <cmath>
+#include <string_view>
+#include <vector>
 
 #include "vast/base.hpp"
 #include "vast/value_index.hpp"
 
 namespace vast {
 
+// -- column_batch -------------------------------------------------------------
+
+size_t column_batch::size() const {
+  auto f = [](const auto& xs) { return static_cast<size_t>(xs.size()); };
+  return caf::visit(f, values);
+}
+
+bool column_batch::is_valid(size_t i) const {
+  VAST_ASSERT(i < size());
+  if (valid != nullptr)
+    return (*valid)[i];
+  if (auto xs = caf::get_if<std::vector<data_view>>(&values))
+    return !caf::holds_alternative<caf::none_t>((*xs)[i]);
+  return true;
+}
+
+uint64_t column_batch::valid_block(size_t i) const {
+  using word_type = word<uint64_t>;
+  auto first = i * word_type::width;
+  VAST_ASSERT(first < size());
+  auto bits = std::min(size() - first, size_t{word_type::width});
+  if (valid != nullptr)
+    return valid->blocks()[i] & word_type::lsb_fill(bits);
+  auto xs = caf::get_if<std::vector<data_view>>(&values);
+  if (xs == nullptr)
+    return word_type::lsb_fill(bits);
+  auto result = word_type::none;
+  for (size_t k = 0; k < bits; ++k)
+    if (!caf::holds_alternative<caf::none_t>((*xs)[first + k]))
+      result |= word_type::lsb1 << k;
+  return result;
+}
+
+data_view column_batch::at(size_t i) const {
+  VAST_ASSERT(i < size());
+  return caf::visit(detail::overload(
+    [&](const std::vector<data_view>& xs) { return xs[i]; },
+    [&](const auto& xs) { return make_data_view(xs[i]); }
+  ), values);
+}
+
 // -- value_index --------------------------------------------------------------
 
 value_index::value_index(vast::type x) : type_{std::move(x)} {
@@ -48,6 +92,36 @@ expected<void> value_index::append(data_view x, id pos) {
   return {};
 }
 
+expected<void> value_index::append(const column_batch& xs, id first) {
+  auto off = mask_.size();
+  if (first < off)
+    // Can only append at the end
+    return make_error(ec::unspecified, first, '<', off);
+  auto n = xs.size();
+  if (n == 0)
+    return {};
+  // Record nil values one block at a time. The nil bitmap only grows up to
+  // the last nil value, so blocks without nil values cost nothing.
+  using word_type = word<uint64_t>;
+  for (size_t base = 0; base < n; base += word_type::width) {
+    auto bits = std::min(n - base, size_t{word_type::width});
+    auto nils = ~xs.valid_block(base / word_type::width)
+                & word_type::lsb_fill(bits);
+    if (nils == word_type::none)
+      continue;
+    none_.append_bits(false, first + base - none_.size());
+    if (nils == word_type::lsb_fill(bits))
+      none_.append_bits(true, bits);
+    else
+      none_.append_block(nils, bits);
+  }
+  if (!append_batch_impl(xs, first))
+    return make_error(ec::unspecified, "append_batch_impl");
+  mask_.append_bits(false, first - off);
+  mask_.append_bits(true, n);
+  return {};
+}
+
 expected<ids> value_index::lookup(relational_operator op, data_view x) const {
   if (caf::holds_alternative<caf::none_t>(x)) {
     if (op == equal)
@@ -70,6 +144,15 @@ const type& value_index::type() const {
   return type_;
 }
 
+bool value_index::append_batch_impl(const column_batch& xs, id first) {
+  auto result = true;
+  xs.each_valid_range([&](size_t i, size_t j) {
+    for (; result && i < j; ++i)
+      result = append_impl(xs.at(i), first + i);
+  });
+  return result;
+}
+
 caf::error value_index::serialize(caf::serializer& sink) const {
   return sink(mask_, none_);
 }
@@ -110,19 +193,42 @@ caf::error inspect(caf::deserializer& source, value_index_ptr& x) {
 
 // -- string_index -------------------------------------------------------------
 
-string_index::string_index(vast::type t, size_t max_length)
+namespace {
+
+// Packs the three characters starting at position *i* into a trigram key.
+uint32_t trigram(std::string_view str, size_t i) {
+  auto c = [&](size_t j) { return uint32_t{static_cast<uint8_t>(str[i + j])}; };
+  return c(0) << 16 | c(1) << 8 | c(2);
+}
+
+} // namespace <anonymous>
+
+string_index::string_index(vast::type t, size_t max_length, bool trigrams)
   : value_index{std::move(t)},
-    max_length_{max_length} {
+    max_length_{max_length},
+    trigrams_enabled_{trigrams} {
 }
 
+// The type of the index determines whether it has trigrams, so that indexes
+// without trigrams keep the layout that predates them.
 caf::error string_index::serialize(caf::serializer& sink) const {
   return caf::error::eval([&] { return value_index::serialize(sink); },
-                          [&] { return sink(max_length_, length_, chars_); });
+                          [&] { return sink(max_length_, length_, chars_); },
+                          [&]() -> caf::error {
+                            if (!trigrams_enabled_)
+                              return caf::none;
+                            return sink(trigrams_);
+                          });
 }
 
 caf::error string_index::deserialize(caf::deserializer& source) {
   return caf::error::eval([&] { return value_index::deserialize(source); },
-                          [&] { return source(max_length_, length_, chars_); });
+                          [&] { return source(max_length_, length_, chars_); },
+                          [&]() -> caf::error {
+                            if (!trigrams_enabled_)
+                              return caf::none;
+                            return source(trigrams_);
+                          });
 }
 
 void string_index::init() {
@@ -148,6 +254,16 @@ bool string_index::append_impl(data_view x, id pos) {
     chars_[i].skip(pos - chars_[i].size());
     chars_[i].append(static_cast<uint8_t>((*str)[i]));
   }
+  if (trigrams_enabled_) {
+    for (auto i = 0u; i + 3 <= length; ++i) {
+      auto& bm = trigrams_[trigram(*str, i)];
+      // A string may contain the same trigram multiple times.
+      if (bm.size() > pos)
+        continue;
+      bm.append_bits(false, pos - bm.size());
+      bm.append_bit(true);
+    }
+  }
   length_.skip(pos - length_.size());
   length_.append(length);
   return true;
@@ -195,6 +311,12 @@ string_index::lookup_impl(relational_operator op, data_view x) const {
             return ids{offset(), op == ni};
           if (str_size > chars_.size())
             return ids{offset(), op == not_ni};
+          if (trigrams_enabled_ && str_size >= 3) {
+            auto result = substring_lookup(str.substr(0, str_size));
+            if (op == not_ni)
+              result.flip();
+            return result;
+          }
           // TODO: Be more clever than iterating over all k-grams (#45).
           ids result{offset(), false};
           for (auto i = 0u; i < chars_.size() - str_size + 1; ++i) {
@@ -222,6 +344,105 @@ string_index::lookup_impl(relational_operator op, data_view x) const {
   ), x);
 }
 
+ids string_index::substring_lookup(std::string_view str) const {
+  VAST_ASSERT(str.size() >= 3);
+  VAST_ASSERT(str.size() <= chars_.size());
+  // Select the strings that contain all trigrams as candidates.
+  std::vector<bitmap_operand<ewah_bitmap>> xs;
+  for (auto i = 0u; i + 3 <= str.size(); ++i) {
+    auto j = trigrams_.find(trigram(str, i));
+    if (j == trigrams_.end())
+      return ids{offset(), false};
+    xs.push_back({&j->second, detail::block_operation::and_op});
+  }
+  ids candidates = fold_eval(xs);
+  candidates.append_bits(false, offset() - candidates.size());
+  // The trigram index is exact for strings of three characters. Otherwise,
+  // the trigrams may occur at different positions.
+  if (str.size() == 3 || all<0>(candidates))
+    return candidates;
+  // Limit the positions to check to the length of the longest candidate.
+  auto max_length = str.size();
+  auto last = chars_.size();
+  while (max_length < last) {
+    auto mid = max_length + (last - max_length + 1) / 2;
+    auto longer = length_.lookup(greater_equal, static_cast<uint32_t>(mid));
+    if (any<1>(longer & candidates))
+      max_length = mid;
+    else
+      last = mid - 1;
+  }
+  ids result{offset(), false};
+  for (auto i = 0u; i + str.size() <= max_length; ++i) {
+    auto substr = candidates;
+    for (auto j = 0u; j < str.size() && any<1>(substr); ++j)
+      substr &= chars_[i + j].lookup(equal, static_cast<uint8_t>(str[j]));
+    result |= substr;
+  }
+  return result;
+}
+
+// -- hash_index ---------------------------------------------------------------
+
+caf::error hash_index::serialize(caf::serializer& sink) const {
+  return caf::error::eval([&] { return value_index::serialize(sink); },
+                          [&] { return sink(values_); });
+}
+
+caf::error hash_index::deserialize(caf::deserializer& source) {
+  return caf::error::eval([&] { return value_index::deserialize(source); },
+                          [&] { return source(values_); });
+}
+
+hash_index::digest_type hash_index::digest(std::string_view str) {
+  xxhash64 h;
+  h(str.data(), str.size());
+  return static_cast<digest_type>(h);
+}
+
+bool hash_index::append_impl(data_view x, id pos) {
+  auto str = caf::get_if<view<std::string>>(&x);
+  if (!str)
+    return false;
+  auto& entries = values_[digest(*str)];
+  auto i = std::find_if(entries.begin(), entries.end(),
+                        [&](const entry& x) { return x.value == *str; });
+  if (i == entries.end())
+    i = entries.insert(entries.end(), entry{std::string{*str}, {}});
+  auto& bm = i->positions;
+  bm.append_bits(false, pos - bm.size());
+  bm.append_bit(true);
+  return true;
+}
+
+expected<ids>
+hash_index::lookup_impl(relational_operator op, data_view x) const {
+  return caf::visit(detail::overload(
+    [&](auto x) -> expected<ids> {
+      return make_error(ec::type_clash, materialize(x));
+    },
+    [&](view<std::string> str) -> expected<ids> {
+      if (op != equal && op != not_equal)
+        return make_error(ec::unsupported_operator, op);
+      auto i = values_.find(digest(str));
+      if (i == values_.end())
+        return ids{offset(), op == not_equal};
+      for (auto& x : i->second) {
+        if (x.value != str)
+          continue;
+        ids result = x.positions;
+        result.append_bits(false, offset() - result.size());
+        if (op == not_equal)
+          result.flip();
+        return result;
+      }
+      return ids{offset(), op == not_equal};
+    },
+    [&](view<vector> xs) { return detail::container_lookup(*this, op, xs); },
+    [&](view<set> xs) { return detail::container_lookup(*this, op, xs); }
+  ), x);
+}
+
 // -- address_index ------------------------------------------------------------
 
 caf::error address_index::serialize(caf::serializer& sink) const {
@@ -240,6 +461,25 @@ void address_index::init() {
     bytes_.fill(byte_index{8});
 }
 
+bool address_index::append_batch_impl(const column_batch& xs, id first) {
+  auto addrs = caf::get_if<span<const address>>(&xs.values);
+  if (!addrs)
+    return value_index::append_batch_impl(xs, first);
+  init();
+  auto ptr = addrs->data();
+  xs.each_valid_range([&](size_t i, size_t j) {
+    // Process one byte at a time, such that common prefixes turn into runs.
+    for (auto k = 0u; k < 16; ++k) {
+      bytes_[k].skip(first + i - bytes_[k].size());
+      bytes_[k].append(ptr + i, ptr + j,
+                       [=](const address& a) { return a.data()[k]; });
+    }
+    v4_.skip(first + i - v4_.size());
+    v4_.append(ptr + i, ptr + j, [](const address& a) { return a.is_v4(); });
+  });
+  return true;
+}
+
 bool address_index::append_impl(data_view x, id pos) {
   init();
   auto addr = caf::get_if<view<address>>(&x);
@@ -414,6 +654,21 @@ void port_index::init() {
   }
 }
 
+bool port_index::append_batch_impl(const column_batch& xs, id first) {
+  auto ports = caf::get_if<span<const port>>(&xs.values);
+  if (!ports)
+    return value_index::append_batch_impl(xs, first);
+  init();
+  auto ptr = ports->data();
+  xs.each_valid_range([&](size_t i, size_t j) {
+    num_.skip(first + i - num_.size());
+    num_.append(ptr + i, ptr + j, [](const port& p) { return p.number(); });
+    proto_.skip(first + i - proto_.size());
+    proto_.append(ptr + i, ptr + j, [](const port& p) { return p.type(); });
+  });
+  return true;
+}
+
 bool port_index::append_impl(data_view x, id pos) {
   if (auto p = caf::get_if<view<port>>(&x)) {
     init();
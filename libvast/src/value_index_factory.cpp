@@ -63,6 +63,16 @@ value_index_ptr make_arithmetic(type x) {
   return nullptr;
 }
 
+value_index_ptr make_string_index(type x) {
+  auto index = extract_attribute(x, "index");
+  // High-cardinality columns benefit from a dictionary of distinct values.
+  if (index && *index == "hash")
+    return std::make_unique<hash_index>(std::move(x));
+  auto max_size = extract_max_size(x);
+  auto trigrams = index && *index == "trigram";
+  return std::make_unique<string_index>(std::move(x), max_size, trigrams);
+}
+
 template <class T, class Index>
 auto add_value_index_factory() {
   return factory<value_index>::add(T{}, make<Index>);
@@ -94,7 +104,7 @@ void factory_traits<value_index>::initialize() {
   add_value_index_factory<address_type, address_index>();
   add_value_index_factory<subnet_type, subnet_index>();
   add_value_index_factory<port_type, port_index>();
-  add_container_index_factory<string_type, string_index>();
+  factory<value_index>::add(string_type{}, make_string_index);
   add_container_index_factory<vector_type, sequence_index>();
   add_container_index_factory<set_type, sequence_index>();
 }
@@ -11,8 +11,13 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <chrono>
+#include <random>
+
 #include "vast/bitmap.hpp"
+#include "vast/detail/block_kernels.hpp"
 #include "vast/ewah_bitmap.hpp"
+#include "vast/roaring_bitmap.hpp"
 #include "vast/ids.hpp"
 #include "vast/null_bitmap.hpp"
 #include "vast/concept/printable/to_string.hpp"
@@ -476,6 +481,14 @@ TEST(wah_bitmap) {
 
 FIXTURE_SCOPE_END()
 
+FIXTURE_SCOPE(roaring_bitmap_tests, bitmap_test_harness<roaring_bitmap>)
+
+TEST(roaring_bitmap) {
+  execute();
+}
+
+FIXTURE_SCOPE_END()
+
 FIXTURE_SCOPE(bitmap_tests, bitmap_test_harness<bitmap>)
 
 TEST(bitmap) {
@@ -912,3 +925,295 @@ TEST(EWAH RLE print 2) {
   //CHECK_EQUAL(str, "1F1T421F2T");
   CHECK_EQUAL(str, "1F1T62F320F39F2T");
 }
+
+namespace {
+
+// Generates an EWAH bitmap that mixes runs and dirty blocks.
+ewah_bitmap make_random_ewah(std::mt19937_64& gen, size_t size,
+                             size_t dirty_percent) {
+  ewah_bitmap result;
+  while (result.size() < size) {
+    auto remaining = size - result.size();
+    if (gen() % 100 < dirty_percent) {
+      auto n = std::min(remaining, size_t{ewah_bitmap::word_type::width});
+      result.append_block(gen(), n);
+    } else {
+      auto n = std::min(remaining, gen() % 500 + 1);
+      result.append_bits(gen() % 2 == 0, n);
+    }
+  }
+  return result;
+}
+
+template <bool FillLHS, bool FillRHS, class Operation>
+void check_binary_eval(const ewah_bitmap& x, const ewah_bitmap& y,
+                       detail::block_operation op, Operation f) {
+  auto expected = binary_eval<FillLHS, FillRHS>(x, y, f);
+  CHECK_EQUAL(binary_eval(x, y, op, detail::scalar_block_kernels()),
+              expected);
+  CHECK_EQUAL(binary_eval(x, y, op, detail::simd_block_kernels()),
+              expected);
+}
+
+} // namespace <anonymous>
+
+TEST(EWAH specialized bitwise operations) {
+  using detail::block_operation;
+  std::mt19937_64 gen{42};
+  for (auto i = 0; i < 100; ++i) {
+    auto x = make_random_ewah(gen, gen() % 5000, i % 100);
+    auto y = make_random_ewah(gen, gen() % 5000, 100 - i % 100);
+    if (i % 3 == 0)
+      x.flip();
+    check_binary_eval<false, false>(x, y, block_operation::and_op,
+                                    [](auto a, auto b) { return a & b; });
+    check_binary_eval<true, true>(x, y, block_operation::or_op,
+                                  [](auto a, auto b) { return a | b; });
+    check_binary_eval<true, true>(x, y, block_operation::xor_op,
+                                  [](auto a, auto b) { return a ^ b; });
+    check_binary_eval<true, false>(x, y, block_operation::and_not_op,
+                                   [](auto a, auto b) { return a & ~b; });
+  }
+  MESSAGE("type-erased bitmaps dispatch to the specialized algorithms");
+  auto x = make_random_ewah(gen, 1000, 50);
+  auto y = make_random_ewah(gen, 2000, 50);
+  CHECK_EQUAL(bitmap{x} & bitmap{y}, bitmap{x & y});
+  CHECK_EQUAL(bitmap{x} - bitmap{y}, bitmap{x - y});
+  CHECK_EQUAL(bitmap{x} | bitmap{null_bitmap{y.size(), true}},
+              bitmap{ewah_bitmap{y.size(), true}});
+}
+
+// Compares the block kernels against the generic bitwise evaluation. Disabled
+// by default, since it measures rather than verifies.
+TEST_DISABLED(EWAH bitwise operations benchmark) {
+  using namespace std::chrono;
+  using detail::block_operation;
+  std::mt19937_64 gen{42};
+  constexpr int runs = 10;
+  auto measure = [&](auto f) {
+    auto first = steady_clock::now();
+    for (int i = 0; i < runs; ++i)
+      f();
+    return duration_cast<microseconds>(steady_clock::now() - first) / runs;
+  };
+  for (auto dirty_percent : {10u, 50u, 90u}) {
+    auto x = make_random_ewah(gen, 10'000'000, dirty_percent);
+    auto y = make_random_ewah(gen, 10'000'000, dirty_percent);
+    ewah_bitmap generic;
+    ewah_bitmap scalar;
+    ewah_bitmap simd;
+    auto f = [](auto a, auto b) { return a & b; };
+    auto generic_time = measure([&] {
+      generic = binary_eval<false, false>(x, y, f);
+    });
+    auto scalar_time = measure([&] {
+      scalar = binary_eval(x, y, block_operation::and_op,
+                           detail::scalar_block_kernels());
+    });
+    auto simd_time = measure([&] {
+      simd = binary_eval(x, y, block_operation::and_op);
+    });
+    CHECK_EQUAL(scalar, generic);
+    CHECK_EQUAL(simd, generic);
+    MESSAGE(dirty_percent << "% dirty blocks: generic " << generic_time.count()
+            << "us, scalar " << scalar_time.count() << "us, "
+            << detail::simd_block_kernels().name << " "
+            << simd_time.count() << "us");
+  }
+}
+
+namespace {
+
+template <class Container>
+bool holds(const roaring_bitmap& bm, size_t i) {
+  return caf::holds_alternative<Container>(bm.chunks()[i].data);
+}
+
+} // namespace <anonymous>
+
+TEST(Roaring containers) {
+  using array = roaring_bitmap::array_container;
+  using bitset = roaring_bitmap::bitset_container;
+  using runs = roaring_bitmap::run_container;
+  using full = roaring_bitmap::full_container;
+  MESSAGE("sparse positions in far apart chunks");
+  roaring_bitmap x;
+  x.append_bits(false, 42);
+  x.append_bit(true);
+  x.append_bits(false, 1'000'000'000'000);
+  x.append_bit(true);
+  x.append_bits(false, 7);
+  REQUIRE_EQUAL(x.chunks().size(), 2u);
+  CHECK(holds<array>(x, 0));
+  CHECK(holds<array>(x, 1));
+  CHECK_EQUAL(x.size(), 1'000'000'000'051u);
+  CHECK_EQUAL(rank(x), 2u);
+  CHECK_EQUAL(rank(x, 1'000'000'000'000), 1u);
+  CHECK_EQUAL(select(x, 1), 42u);
+  CHECK_EQUAL(select(x, 2), 1'000'000'000'043u);
+  CHECK_EQUAL(select(x, 3), roaring_bitmap::word_type::npos);
+  CHECK_EQUAL(select(x, -1), 1'000'000'000'043u);
+  std::vector<roaring_bitmap::size_type> positions;
+  for (auto i : select(x))
+    positions.push_back(i);
+  CHECK_EQUAL(positions, (std::vector<roaring_bitmap::size_type>{
+                           42, 1'000'000'000'043}));
+  MESSAGE("clustered positions");
+  roaring_bitmap y;
+  y.append_bits(true, 100'000);
+  REQUIRE_EQUAL(y.chunks().size(), 2u);
+  CHECK(holds<runs>(y, 0));
+  CHECK(holds<runs>(y, 1));
+  MESSAGE("dense and scattered positions");
+  roaring_bitmap z;
+  for (auto i = 0; i < 1024; ++i)
+    z.append_block(0x5555555555555555);
+  REQUIRE_EQUAL(z.chunks().size(), 1u);
+  CHECK(holds<bitset>(z, 0));
+  CHECK_EQUAL(rank(z), 32'768u);
+  MESSAGE("operations pick the container of the result");
+  auto yz = y - z;
+  REQUIRE_EQUAL(yz.chunks().size(), 2u);
+  CHECK(holds<bitset>(yz, 0));
+  CHECK(holds<runs>(yz, 1));
+  CHECK_EQUAL(rank(yz), 100'000u - 32'768u);
+  auto zy = z - y;
+  CHECK(zy.chunks().empty());
+  CHECK_EQUAL(zy.size(), y.size());
+  auto xy = x | y;
+  REQUIRE_EQUAL(xy.chunks().size(), 3u);
+  CHECK(holds<runs>(xy, 0));
+  CHECK_EQUAL(rank(xy), 100'001u);
+  CHECK_EQUAL(xy & x, x);
+  MESSAGE("complements share a single entry for full chunks");
+  auto nx = ~x;
+  REQUIRE_EQUAL(nx.chunks().size(), 3u);
+  CHECK(holds<runs>(nx, 0));
+  CHECK(holds<full>(nx, 1));
+  CHECK(holds<runs>(nx, 2));
+  CHECK_EQUAL(rank(nx), x.size() - 2);
+  CHECK_EQUAL(select(nx, 43), 43u);
+  CHECK_EQUAL(~nx, x);
+  CHECK_EQUAL(nx & x, roaring_bitmap(x.size()));
+  CHECK_EQUAL(nx | x, roaring_bitmap(x.size(), true));
+  CHECK_EQUAL((nx | x).chunks().size(), 2u);
+  CHECK_EQUAL(nx ^ x, roaring_bitmap(x.size(), true));
+  CHECK_EQUAL(rank(nx - y), rank(nx) - 99'999u);
+}
+
+TEST(Roaring type-erased operations) {
+  ewah_bitmap x;
+  x.append_bits(false, 10);
+  x.append_bits(true, 10);
+  x.append_bits(false, 100'000);
+  x.append_bits(true, 5);
+  roaring_bitmap y;
+  y.append(x);
+  MESSAGE("conversion preserves the bits");
+  CHECK_EQUAL(to_string(y), to_string(x));
+  CHECK_EQUAL(bitmap{x}, bitmap{y});
+  MESSAGE("mixed operations produce Roaring bitmaps");
+  auto hits = bitmap{roaring_bitmap{}};
+  hits |= bitmap{x};
+  CHECK(caf::holds_alternative<roaring_bitmap>(hits));
+  CHECK_EQUAL(hits, bitmap{x});
+  auto all = ewah_bitmap{200'000, true};
+  auto delta = bitmap{all} - hits;
+  CHECK(caf::holds_alternative<roaring_bitmap>(delta));
+  CHECK_EQUAL(rank(delta), 200'000u - 15u);
+  CHECK_EQUAL(delta, bitmap{all - x});
+  MESSAGE("comparisons consider the bits only");
+  CHECK(bitmap{x} != bitmap{ewah_bitmap{x.size(), true}});
+  CHECK(bitmap{y} != bitmap{null_bitmap{y.size() + 1, false}});
+}
+
+TEST(fold evaluation) {
+  using detail::block_operation;
+  std::mt19937_64 gen{42};
+  auto ops = {block_operation::and_op, block_operation::or_op,
+              block_operation::xor_op, block_operation::and_not_op};
+  // Evaluates the fold pairwise.
+  auto reference = [](const std::vector<bitmap_operand<ewah_bitmap>>& xs) {
+    auto operand = [](auto& x) {
+      auto result = *x.bitmap;
+      if (x.negate)
+        result.flip();
+      return result;
+    };
+    auto result = operand(xs[0]);
+    for (auto i = 1u; i < xs.size(); ++i) {
+      auto x = operand(xs[i]);
+      switch (xs[i].op) {
+        case block_operation::and_op:
+          result &= x;
+          break;
+        case block_operation::or_op:
+          result |= x;
+          break;
+        case block_operation::xor_op:
+          result ^= x;
+          break;
+        case block_operation::and_not_op:
+          result -= x;
+          break;
+      }
+    }
+    return result;
+  };
+  for (auto i = 0; i < 300; ++i) {
+    std::vector<ewah_bitmap> bitmaps;
+    auto n = gen() % 20 + 1;
+    for (auto j = 0u; j < n; ++j)
+      bitmaps.push_back(make_random_ewah(gen, gen() % 3000, gen() % 100));
+    std::vector<bitmap_operand<ewah_bitmap>> xs;
+    for (auto& bm : bitmaps) {
+      // Alternate between folds of a single operation and operation chains.
+      auto op = *(ops.begin() + (i % 3 == 0 ? gen() % 4 : i % 2));
+      xs.push_back({&bm, op, gen() % 4 == 0});
+    }
+    CHECK_EQUAL(fold_eval(xs), reference(xs));
+  }
+  MESSAGE("n-ary operations");
+  std::vector<ewah_bitmap> xs;
+  xs.push_back(make_random_ewah(gen, 1000, 10));
+  xs.push_back(make_random_ewah(gen, 2000, 50));
+  xs.push_back(make_random_ewah(gen, 1500, 90));
+  CHECK_EQUAL(nary_and(xs.begin(), xs.end()), xs[0] & xs[1] & xs[2]);
+  CHECK_EQUAL(nary_or(xs.begin(), xs.end()), xs[0] | xs[1] | xs[2]);
+  CHECK_EQUAL(nary_xor(xs.begin(), xs.end()), xs[0] ^ xs[1] ^ xs[2]);
+  MESSAGE("runs that determine the result");
+  xs.emplace_back(2000, false);
+  CHECK_EQUAL(nary_and(xs.begin(), xs.end()), ewah_bitmap(2000, false));
+  xs.back() = ewah_bitmap{2000, true};
+  CHECK_EQUAL(nary_or(xs.begin(), xs.end()), ewah_bitmap(2000, true));
+  MESSAGE("many bitmaps with long runs");
+  xs.clear();
+  for (auto i = 0; i < 10; ++i) {
+    ewah_bitmap x;
+    for (auto j = 0; j < 5; ++j) {
+      x.append_bits(false, gen() % 100'000);
+      x.append_bits(true, gen() % 1000 + 1);
+    }
+    xs.push_back(std::move(x));
+  }
+  auto expected_and = xs[0];
+  auto expected_or = xs[0];
+  auto expected_xor = xs[0];
+  for (auto i = 1u; i < xs.size(); ++i) {
+    expected_and &= xs[i];
+    expected_or |= xs[i];
+    expected_xor ^= xs[i];
+  }
+  CHECK_EQUAL(nary_and(xs.begin(), xs.end()), expected_and);
+  CHECK_EQUAL(nary_or(xs.begin(), xs.end()), expected_or);
+  CHECK_EQUAL(nary_xor(xs.begin(), xs.end()), expected_xor);
+  MESSAGE("operand cost estimates");
+  ewah_bitmap sparse;
+  sparse.append_bits(false, 90);
+  sparse.append_bits(true, 10);
+  CHECK_EQUAL(detail::operand_cost(sparse, block_operation::and_op, 100), 10u);
+  CHECK_EQUAL(detail::operand_cost(sparse, block_operation::or_op, 200), 190u);
+  CHECK_EQUAL(detail::operand_cost(sparse, block_operation::and_op, 100, true),
+              90u);
+  CHECK_EQUAL(detail::operand_cost(sparse, block_operation::xor_op, 100), 2u);
+}
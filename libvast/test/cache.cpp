@@ -114,3 +114,52 @@ TEST(MRU cache insertion) {
 }
 
 FIXTURE_SCOPE_END()
+
+namespace {
+
+struct weigher {
+  size_t operator()(const std::string& x) const {
+    return x.size();
+  }
+};
+
+using two_queue_cache = detail::two_queue_cache<int, std::string, weigher>;
+
+} // namespace <anonymous>
+
+TEST(2Q cache weight) {
+  two_queue_cache xs{10};
+  xs.emplace(1, "foo");
+  xs.emplace(2, "bar");
+  CHECK_EQUAL(xs.size(), 2u);
+  CHECK_EQUAL(xs.weight(), 6u);
+  // Exceeding the capacity evicts the oldest entry.
+  xs.emplace(3, "quxx");
+  xs.emplace(4, "a");
+  CHECK(!xs.contains(1));
+  CHECK_EQUAL(xs.weight(), 8u);
+  CHECK_EQUAL(xs.statistics().evictions, 1u);
+  // An entry that exceeds the capacity on its own evicts everything else.
+  xs.emplace(5, "0123456789ab");
+  CHECK_EQUAL(xs.size(), 1u);
+  REQUIRE(xs.find(5) != nullptr);
+  CHECK_EQUAL(*xs.find(5), "0123456789ab");
+}
+
+TEST(2Q cache scan resistance) {
+  two_queue_cache xs{8};
+  // Evicting an entry from A1in and requesting it again promotes it into Am.
+  xs.emplace(1, "hot");
+  xs.emplace(2, "aa");
+  xs.emplace(3, "bbbb");
+  CHECK(!xs.contains(1));
+  CHECK(xs.find(1) == nullptr);
+  xs.emplace(1, "hot");
+  // A scan over many cold entries leaves the hot entry alone.
+  for (auto i = 10; i < 20; ++i)
+    xs.emplace(i, "cc");
+  REQUIRE(xs.find(1) != nullptr);
+  CHECK_EQUAL(*xs.find(1), "hot");
+  CHECK_EQUAL(xs.statistics().misses, 1u);
+  CHECK_EQUAL(xs.statistics().hits, 2u);
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#define SUITE object_pool
+#include "vast/test/test.hpp"
+
+#include "vast/detail/object_pool.hpp"
+
+#include <vector>
+
+#include <caf/make_counted.hpp>
+
+using namespace vast;
+
+TEST(object pool) {
+  auto pool = caf::make_counted<detail::object_pool<std::vector<int>>>(2);
+  MESSAGE("an empty pool hands out default-constructed objects");
+  CHECK(pool->acquire().empty());
+  MESSAGE("released objects keep their storage");
+  std::vector<int> xs;
+  xs.reserve(42);
+  auto buffer = xs.data();
+  pool->release(std::move(xs));
+  CHECK_EQUAL(pool->size(), 1u);
+  auto ys = pool->acquire();
+  CHECK(ys.data() == buffer);
+  CHECK_GREATER_EQUAL(ys.capacity(), 42u);
+  CHECK_EQUAL(pool->size(), 0u);
+  MESSAGE("a full pool discards released objects");
+  for (auto i = 0; i < 3; ++i)
+    pool->release(std::vector<int>(10));
+  CHECK_EQUAL(pool->size(), 2u);
+}
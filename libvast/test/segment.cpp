@@ -22,8 +22,16 @@
 #include <caf/binary_deserializer.hpp>
 #include <caf/binary_serializer.hpp>
 
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "vast/compression.hpp"
+#include "vast/default_table_slice_builder.hpp"
 #include "vast/ids.hpp"
 #include "vast/load.hpp"
+#include "vast/packed_table_slice.hpp"
+#include "vast/packed_table_slice_builder.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/save.hpp"
 
@@ -47,6 +55,138 @@ TEST(construction and querying) {
   CHECK_EQUAL(*slices[1], *zeek_conn_log_slices[2]);
 }
 
+TEST(compressed construction and querying) {
+  std::vector<compression> methods = {compression::null, compression::lz4};
+#ifdef VAST_HAVE_SNAPPY
+  methods.push_back(compression::snappy);
+#endif
+  for (auto method : methods) {
+    segment_builder builder{method};
+    for (auto& slice : zeek_conn_log_slices)
+      REQUIRE(!builder.add(slice));
+    auto x = builder.finish();
+    REQUIRE_NOT_EQUAL(x, nullptr);
+    CHECK(x->compression_method() == method);
+    MESSAGE("load segment from chunk");
+    std::vector<char> buf;
+    REQUIRE_EQUAL(save(nullptr, buf, x), caf::none);
+    auto y = segment::make(chunk::make(std::move(buf)));
+    REQUIRE(y);
+    CHECK(y->compression_method() == method);
+    auto xs = y->lookup(make_ids({0, 6, 19, 21}));
+    REQUIRE(xs);
+    auto& slices = *xs;
+    REQUIRE_EQUAL(slices.size(), 2u);
+    CHECK_EQUAL(*slices[0], *zeek_conn_log_slices[0]);
+    CHECK_EQUAL(*slices[1], *zeek_conn_log_slices[2]);
+  }
+}
+
+TEST(zero-copy lookup) {
+  MESSAGE("re-encode the test slices as packed table slices");
+  std::vector<table_slice_ptr> slices;
+  for (auto& slice : zeek_conn_log_slices) {
+    packed_table_slice_builder builder{slice->layout()};
+    for (size_t row = 0; row < slice->rows(); ++row)
+      for (size_t col = 0; col < slice->columns(); ++col)
+        REQUIRE(builder.add(slice->at(row, col)));
+    auto packed = builder.finish();
+    REQUIRE_NOT_EQUAL(packed, nullptr);
+    packed.unshared().offset(slice->offset());
+    slices.push_back(std::move(packed));
+  }
+  segment_builder builder;
+  for (auto& slice : slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  auto xs = x->lookup(make_ids({0, 6, 19, 21}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 2u);
+  for (auto& slice : *xs) {
+    REQUIRE_EQUAL(slice->implementation_id(), packed_table_slice::class_id);
+    MESSAGE("the slice must point into the segment chunk");
+    auto& packed = static_cast<const packed_table_slice&>(*slice);
+    CHECK(packed.chunk()->begin() >= x->chunk()->begin());
+    CHECK(packed.chunk()->end() <= x->chunk()->end());
+  }
+  CHECK_EQUAL(*xs->at(0), *zeek_conn_log_slices[0]);
+  CHECK_EQUAL(*xs->at(1), *zeek_conn_log_slices[2]);
+}
+
+TEST(footer index) {
+  segment_builder builder;
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  auto index = x->slices();
+  REQUIRE_EQUAL(static_cast<size_t>(index.size()),
+                zeek_conn_log_slices.size());
+  for (size_t i = 0; i < zeek_conn_log_slices.size(); ++i) {
+    CHECK_EQUAL(index[i].offset, zeek_conn_log_slices[i]->offset());
+    CHECK_EQUAL(index[i].rows, zeek_conn_log_slices[i]->rows());
+    CHECK_EQUAL(index[i].layout_digest, index[0].layout_digest);
+  }
+  MESSAGE("the footer index points into the chunk");
+  auto first = reinterpret_cast<const char*>(index.data());
+  CHECK(first >= x->chunk()->begin());
+  CHECK(first + index.size() * sizeof(segment_slice_entry)
+        == x->chunk()->end());
+  MESSAGE("lookup IDs at slice boundaries");
+  auto last = zeek_conn_log_slices.back();
+  auto xs = x->lookup(make_ids({7, 8, last->offset() + last->rows() - 1}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 3u);
+  CHECK_EQUAL(*xs->at(0), *zeek_conn_log_slices[0]);
+  CHECK_EQUAL(*xs->at(1), *zeek_conn_log_slices[1]);
+  CHECK_EQUAL(*xs->at(2), *last);
+  MESSAGE("lookup IDs beyond the segment");
+  xs = x->lookup(make_ids({last->offset() + last->rows()}));
+  REQUIRE(xs);
+  CHECK(xs->empty());
+}
+
+TEST(dictionary encoding) {
+  auto layout = record_type{
+    {"state", string_type{}},
+    {"n", count_type{}}
+  };
+  std::vector<std::string> states{"established", "rejected", "half-open"};
+  auto builder = default_table_slice_builder::make(layout);
+  for (count i = 0; i < 100; ++i) {
+    if (i % 10 == 0)
+      REQUIRE(builder->add(caf::none));
+    else
+      REQUIRE(builder->add(make_view(states[i % states.size()])));
+    REQUIRE(builder->add(make_view(i)));
+  }
+  auto slice = builder->finish();
+  REQUIRE_NOT_EQUAL(slice, nullptr);
+  segment_builder plain{compression::null, true};
+  segment_builder coded{compression::null, false, true};
+  REQUIRE(!plain.add(slice));
+  REQUIRE(!coded.add(slice));
+  auto x = plain.finish();
+  auto y = coded.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  REQUIRE_NOT_EQUAL(y, nullptr);
+  MESSAGE("the dictionary shrinks the segment");
+  CHECK_LESS(y->chunk()->size(), x->chunk()->size());
+  MESSAGE("lookups decode the dictionary");
+  auto xs = y->lookup(make_ids({{0, 100}}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 1u);
+  CHECK_EQUAL(xs->at(0)->implementation_id(), packed_table_slice::class_id);
+  CHECK_EQUAL(*xs->at(0), *slice);
+  MESSAGE("projections keep the dictionary");
+  auto projected = project(xs->at(0), {0});
+  REQUIRE_NOT_EQUAL(projected, nullptr);
+  REQUIRE_EQUAL(projected->columns(), 1u);
+  for (size_t row = 0; row < slice->rows(); ++row)
+    CHECK_EQUAL(projected->at(row, 0), slice->at(row, 0));
+}
+
 TEST(serialization) {
   segment_builder builder;
   auto slice = zeek_conn_log_slices[0];
@@ -68,4 +208,64 @@ TEST(serialization) {
                    z->chunk()->begin(), z->chunk()->end()));
 }
 
+TEST(corrupt segments) {
+  segment_builder builder{compression::lz4};
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  std::vector<char> buf{x->chunk()->begin(), x->chunk()->end()};
+  auto descriptor_offset = sizeof(segment_header);
+  auto footer_offset = buf.size() - x->num_slices()
+                                      * sizeof(segment_slice_entry);
+  // Applies a modification to a copy of the segment and loads it.
+  auto corrupt = [&](auto f) {
+    auto copy = buf;
+    f(copy);
+    return segment::make(chunk::make(std::move(copy)));
+  };
+  auto patch = [](std::vector<char>& xs, size_t offset, uint64_t value) {
+    std::memcpy(xs.data() + offset, &value, sizeof(value));
+  };
+  REQUIRE_NOT_EQUAL(corrupt([](auto&) {}), nullptr);
+  MESSAGE("truncated segment");
+  CHECK_EQUAL(corrupt([](auto& xs) { xs.pop_back(); }), nullptr);
+  MESSAGE("overflowing number of slices");
+  CHECK_EQUAL(corrupt([&](auto& xs) {
+                patch(xs, descriptor_offset + 8, uint64_t{1} << 60);
+              }),
+              nullptr);
+  MESSAGE("unknown compression method");
+  CHECK_EQUAL(corrupt([&](auto& xs) { xs[descriptor_offset + 16] = 42; }),
+              nullptr);
+  MESSAGE("slice beyond the payload");
+  CHECK_EQUAL(corrupt([&](auto& xs) {
+                patch(xs, footer_offset + offsetof(segment_slice_entry, end),
+                      footer_offset);
+              }),
+              nullptr);
+  MESSAGE("slice with negative size");
+  CHECK_EQUAL(corrupt([&](auto& xs) {
+                patch(xs, footer_offset + offsetof(segment_slice_entry, start),
+                      uint64_t{1} << 40);
+              }),
+              nullptr);
+  MESSAGE("implausible uncompressed size");
+  CHECK_EQUAL(corrupt([&](auto& xs) {
+                patch(xs,
+                      footer_offset
+                        + offsetof(segment_slice_entry, uncompressed_size),
+                      uint64_t{1} << 50);
+              }),
+              nullptr);
+  MESSAGE("deserializing an implausible number of slices");
+  for (auto num_slices : {uint64_t{1} << 40, ~uint64_t{0}}) {
+    auto copy = buf;
+    patch(copy, descriptor_offset + 8, num_slices);
+    segment_ptr y;
+    CHECK_NOT_EQUAL(load(nullptr, copy, y), caf::none);
+    CHECK_EQUAL(y, nullptr);
+  }
+}
+
 FIXTURE_SCOPE_END()
@@ -20,6 +20,7 @@
 #include "vast/test/fixtures/filesystem.hpp"
 
 #include "vast/ids.hpp"
+#include "vast/packed_table_slice.hpp"
 #include "vast/si_literals.hpp"
 #include "vast/table_slice.hpp"
 
@@ -32,7 +33,7 @@ FIXTURE_SCOPE(segment_store_tests, fixture)
 
 TEST(construction and querying) {
   auto path = directory / "segments";
-  auto store = segment_store::make(path, 512_KiB, 2);
+  auto store = segment_store::make(path, 512_KiB, 1_MiB);
   REQUIRE(store);
   for (auto& slice : zeek_conn_log_slices)
     REQUIRE(!store->put(slice));
@@ -43,7 +44,7 @@ TEST(construction and querying) {
 
 TEST(sessionized extraction) {
   auto path = directory / "segments";
-  auto store = segment_store::make(path, 512_KiB, 2);
+  auto store = segment_store::make(path, 512_KiB, 1_MiB);
   REQUIRE(store);
   for (auto& slice : zeek_conn_log_slices)
     REQUIRE(!store->put(slice));
@@ -59,4 +60,96 @@ TEST(sessionized extraction) {
   REQUIRE(slice2.error() == caf::no_error);
 }
 
+TEST(asynchronous flushing) {
+  auto path = directory / "segments";
+  {
+    // Small segments force the I/O thread to write many of them, while only
+    // one may wait at a time.
+    auto store = segment_store::make(path, 1_KiB, 1_KiB, compression::null, 1);
+    REQUIRE(store);
+    for (auto& slice : zeek_conn_log_slices)
+      REQUIRE(!store->put(slice));
+    auto slices = store->get(make_ids({0, 6, 19, 21}));
+    REQUIRE(slices);
+    CHECK_EQUAL(slices->size(), 2u);
+    REQUIRE(!store->flush());
+  }
+  // All segments and the meta data must be on disk after a flush.
+  auto store = segment_store::make(path, 1_KiB, 1_KiB);
+  REQUIRE(store);
+  auto slices = store->get(make_ids({0, 6, 19, 21}));
+  REQUIRE(slices);
+  CHECK_EQUAL(slices->size(), 2u);
+}
+
+TEST(meta data journal) {
+  auto path = directory / "segments";
+  auto half = zeek_conn_log_slices.size() / 2;
+  // Each session appends the ID ranges of its segments to the journal.
+  for (auto i : {size_t{0}, half}) {
+    auto store = segment_store::make(path, 1_KiB, 1_KiB);
+    REQUIRE(store);
+    for (auto j = i; j < i + half; ++j)
+      REQUIRE(!store->put(zeek_conn_log_slices[j]));
+    REQUIRE(!store->flush());
+  }
+  auto store = segment_store::make(path, 1_KiB, 1_KiB);
+  REQUIRE(store);
+  auto last = zeek_conn_log_slices[2 * half - 1]->offset();
+  auto slices = store->get(make_ids({{0, 1}, {last, last + 1}}));
+  REQUIRE(slices);
+  REQUIRE_EQUAL(slices->size(), 2u);
+  CHECK_EQUAL(slices->back()->offset(), last);
+}
+
+TEST(parallel extraction) {
+  auto path = directory / "segments";
+  {
+    auto store = segment_store::make(path, 1_KiB, 1_KiB);
+    REQUIRE(store);
+    for (auto& slice : zeek_conn_log_slices)
+      REQUIRE(!store->put(slice));
+    REQUIRE(!store->flush());
+  }
+  // Start with a cold cache, so that the session must load every segment.
+  auto store = segment_store::make(path, 1_KiB, 1_KiB);
+  REQUIRE(store);
+  store->parallel_extraction(4, 1_MiB);
+  auto session = store->extract(make_ids({0, 6, 19, 21, 40, 100}));
+  std::vector<id> offsets;
+  for (auto slice = session->next(); slice; slice = session->next())
+    offsets.push_back((*slice)->offset());
+  std::vector<id> expected{0, 16, 40, 96};
+  CHECK(offsets == expected);
+}
+
+TEST(columnar extraction with projection) {
+  auto path = directory / "segments";
+  {
+    auto store = segment_store::make(path, 1_KiB, 1_KiB, compression::null,
+                                     1, true);
+    REQUIRE(store);
+    for (auto& slice : zeek_conn_log_slices)
+      REQUIRE(!store->put(slice));
+    REQUIRE(!store->flush());
+  }
+  auto store = segment_store::make(path, 1_KiB, 1_KiB);
+  REQUIRE(store);
+  auto& original = zeek_conn_log_slices[2];
+  auto session = store->extract(make_ids({16}), {0, 2, 9999});
+  auto slice = session->next();
+  REQUIRE(slice);
+  auto& x = *slice;
+  CHECK_EQUAL(x->implementation_id(), packed_table_slice::class_id);
+  CHECK_EQUAL(x->offset(), original->offset());
+  REQUIRE_EQUAL(x->rows(), original->rows());
+  REQUIRE_EQUAL(x->columns(), 2u);
+  CHECK(x->layout().fields[1] == original->layout().fields[2]);
+  for (size_t row = 0; row < x->rows(); ++row) {
+    CHECK_EQUAL(x->at(row, 0), original->at(row, 0));
+    CHECK_EQUAL(x->at(row, 1), original->at(row, 2));
+  }
+  CHECK(!session->next());
+}
+
 FIXTURE_SCOPE_END()
@@ -33,7 +33,8 @@ struct fixture : fixtures::deterministic_actor_system_and_events {
   system::archive_type a;
 
   fixture() {
-    a = self->spawn(system::archive, directory, 10, 1024 * 1024);
+    a = self->spawn(system::archive, directory, 10, 1024 * 1024,
+                    compression::null, false, false);
     self->send(a, system::exporter_atom::value, self);
   }
 
@@ -41,6 +41,7 @@ struct fixture : fixtures::deterministic_actor_system_and_events {
   fixture() {
     layout.fields.emplace_back("x", count_type{});
     layout.fields.emplace_back("y", count_type{});
+    layout.fields.emplace_back("z", count_type{});
     layout.name("test");
     // Spin up our dummies.
     auto& x_indexers= indexers["x"];
@@ -65,7 +66,7 @@ struct fixture : fixtures::deterministic_actor_system_and_events {
     for (auto& [expr_position, pred]: resolved) {
       VAST_ASSERT(caf::holds_alternative<data_extractor>(pred.lhs));
       auto& dx = caf::get<data_extractor>(pred.lhs);
-      std::string field_name = dx.offset.back() == 0 ? "x" : "y";
+      auto& field_name = layout.fields[dx.offset.back()].name;
       auto& xs =  indexers[field_name];
       for (auto& x : xs)
         triples.emplace_back(expr_position, curried(pred), x);
@@ -94,4 +95,20 @@ TEST(evaluation queries) {
   CHECK_EQUAL(query("x == 42 || y != 10"), make_ids({{0, 5}, 8}, 9));
 }
 
+TEST(nested queries) {
+  CHECK_EQUAL(query("! (y != 10)"), make_ids({0, 2, {5, 8}}, 9));
+  CHECK_EQUAL(query("x == 42 && ! (y != 10)"), make_ids({0, 2}, 9));
+  CHECK_EQUAL(query("(x == 42 || y != 10) && y != 10"),
+              make_ids({1, 3, 4, 8}, 9));
+  CHECK_EQUAL(query("(x == 42 && y != 10) || ! (x == 42)"),
+              make_ids({1, 3, 4}, 9));
+}
+
+TEST(predicates without INDEXER actors) {
+  // `z == 1` has no INDEXER actors and thus no hits.
+  CHECK_EQUAL(query("x == 42 || z == 1"), make_ids({{0, 5}}));
+  CHECK_EQUAL(query("! (y != 10 || z == 1)"), make_ids({0, 2, {5, 8}}, 9));
+  CHECK_EQUAL(rank(query("x == 42 && z == 1")), 0u);
+}
+
 FIXTURE_SCOPE_END()
@@ -58,7 +58,8 @@ struct fixture : fixture_base {
   }
 
   void spawn_archive() {
-    archive = self->spawn(system::archive, directory / "archive", 1, 1024);
+    archive = self->spawn(system::archive, directory / "archive", 1, 1024,
+                          compression::null, false, false);
   }
 
   void spawn_importer() {
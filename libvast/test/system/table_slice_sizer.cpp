@@ -0,0 +1,61 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/system/table_slice_sizer.hpp"
+
+#define SUITE system
+#include "vast/test/test.hpp"
+
+using namespace std::chrono_literals;
+using namespace vast;
+using namespace vast::system;
+
+TEST(table slice sizer) {
+  table_slice_sizer sizer{100, 10'000, 1s};
+  MESSAGE("start at the initial size");
+  CHECK_EQUAL(sizer.size(), 100u);
+  CHECK_EQUAL(sizer.batch_size(4), 400u);
+  MESSAGE("shrink for a quiet source");
+  sizer.update(10, 1s);
+  CHECK_EQUAL(sizer.size(), 10u);
+  CHECK_EQUAL(sizer.batch_size(4), 10u);
+  MESSAGE("grow beyond the initial size under load");
+  sizer.update(4'000, 1s);
+  CHECK_EQUAL(sizer.size(), 1'008u);
+  MESSAGE("stop at the ceiling");
+  sizer.update(1'000'000, 1s);
+  CHECK_EQUAL(sizer.size(), 10'000u);
+  CHECK_EQUAL(sizer.batch_size(4), 40'000u);
+  MESSAGE("never drop below a single row");
+  table_slice_sizer idle{100, 10'000, 1s};
+  idle.update(0, 1s);
+  CHECK_EQUAL(idle.size(), 1u);
+  MESSAGE("keep a measured rate of zero");
+  idle.update(0, 1s);
+  CHECK_EQUAL(idle.rate(), 0.);
+  CHECK_EQUAL(idle.batch_size(4), 1u);
+  idle.update(40, 1s);
+  CHECK_EQUAL(idle.size(), 10u);
+}
+
+TEST(table slice sizer without deadline) {
+  table_slice_sizer sizer{100, 10'000, timespan::zero()};
+  sizer.update(10, 1s);
+  CHECK_EQUAL(sizer.size(), 100u);
+  CHECK_EQUAL(sizer.batch_size(2), 200u);
+}
+
+TEST(table slice sizer with initial size above the ceiling) {
+  table_slice_sizer sizer{100, 50, 1s};
+  CHECK_EQUAL(sizer.size(), 50u);
+}
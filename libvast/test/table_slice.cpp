@@ -19,13 +19,21 @@
 
 #include "vast/test/fixtures/table_slices.hpp"
 
+#include <chrono>
+
+#include <caf/binary_deserializer.hpp>
+#include <caf/binary_serializer.hpp>
 #include <caf/make_copy_on_write.hpp>
 #include <caf/test/dsl.hpp>
 
 #include "vast/column_major_matrix_table_slice_builder.hpp"
+#include "vast/columnar_table_slice.hpp"
+#include "vast/columnar_table_slice_builder.hpp"
 #include "vast/default_table_slice.hpp"
 #include "vast/default_table_slice_builder.hpp"
 #include "vast/matrix_table_slice.hpp"
+#include "vast/packed_table_slice.hpp"
+#include "vast/packed_table_slice_builder.hpp"
 #include "vast/row_major_matrix_table_slice_builder.hpp"
 
 using namespace vast;
@@ -97,6 +105,8 @@ TEST_TABLE_SLICE(default_table_slice)
 TEST_TABLE_SLICE(row_major_matrix_table_slice)
 TEST_TABLE_SLICE(column_major_matrix_table_slice)
 TEST_TABLE_SLICE(rebranded_table_slice)
+TEST_TABLE_SLICE(packed_table_slice)
+TEST_TABLE_SLICE(columnar_table_slice)
 
 TEST(random integer slices) {
   record_type layout{
@@ -115,4 +125,264 @@ TEST(random integer slices) {
   CHECK_LESS_EQUAL(*highest, 200);
 }
 
+TEST(columnar table slice with container cells) {
+  record_type layout{
+    {"xs", vector_type{count_type{}}},
+    {"ss", set_type{string_type{}}}
+  };
+  columnar_table_slice_builder builder{layout};
+  auto xs = data{vector{count{1}, count{2}, caf::none}};
+  auto ss = data{set{"foo", "bar"}};
+  REQUIRE(builder.add(make_view(xs)));
+  REQUIRE(builder.add(make_view(ss)));
+  REQUIRE(builder.add(caf::none));
+  REQUIRE(builder.add(caf::none));
+  auto slice = builder.finish();
+  REQUIRE_NOT_EQUAL(slice, nullptr);
+  REQUIRE_EQUAL(slice->rows(), 2u);
+  CHECK_EQUAL(slice->at(0, 0), make_view(xs));
+  CHECK_EQUAL(slice->at(0, 1), make_view(ss));
+  CHECK_EQUAL(slice->at(1, 0), data_view{caf::none});
+  CHECK_EQUAL(slice->at(1, 1), data_view{caf::none});
+  MESSAGE("the builder starts over after finishing a slice");
+  REQUIRE(builder.add(make_view(xs)));
+  REQUIRE(builder.add(make_view(ss)));
+  auto next = builder.finish();
+  REQUIRE_NOT_EQUAL(next, nullptr);
+  REQUIRE_EQUAL(next->rows(), 1u);
+  CHECK_EQUAL(next->at(0, 0), make_view(xs));
+}
+
+TEST(builders recycle the storage of destroyed slices) {
+  record_type layout{{"s", string_type{}}, {"x", count_type{}}};
+  MESSAGE("default builder");
+  default_table_slice_builder builder{layout};
+  for (count i = 0; i < 3; ++i)
+    REQUIRE(builder.add(make_view("foo"), i));
+  auto slice = builder.finish();
+  REQUIRE_EQUAL(slice->rows(), 3u);
+  slice = nullptr;
+  REQUIRE(builder.add(make_view("bar"), count{42}));
+  REQUIRE(builder.add(make_data_view("baz")));
+  slice = builder.finish();
+  REQUIRE_EQUAL(slice->rows(), 2u);
+  CHECK_EQUAL(slice->at(0, 0), make_data_view("bar"));
+  CHECK_EQUAL(slice->at(0, 1), make_data_view(count{42}));
+  CHECK_EQUAL(slice->at(1, 0), make_data_view("baz"));
+  CHECK_EQUAL(slice->at(1, 1), data_view{caf::none});
+  MESSAGE("columnar builder");
+  columnar_table_slice_builder columnar_builder{layout};
+  for (count i = 0; i < 3; ++i)
+    REQUIRE(columnar_builder.add(make_view("a string beyond SSO"), i));
+  auto first = columnar_builder.finish();
+  auto strings = [](const table_slice_ptr& x) {
+    auto& xs = dynamic_cast<const columnar_table_slice&>(*x).columns_data();
+    auto& ys = caf::get<columnar_table_slice::string_array>(xs[0].values);
+    return ys.bytes.data();
+  };
+  auto buffer = strings(first);
+  first = nullptr;
+  // The builder already holds the buffers for the second slice, so the third
+  // slice picks up the buffers of the first.
+  REQUIRE(columnar_builder.add(make_view("bar"), count{1}));
+  auto second = columnar_builder.finish();
+  REQUIRE(columnar_builder.add(data_view{caf::none}));
+  REQUIRE(columnar_builder.add(make_data_view(count{2})));
+  REQUIRE(columnar_builder.add(make_data_view("qux")));
+  REQUIRE(columnar_builder.add(data_view{caf::none}));
+  auto third = columnar_builder.finish();
+  CHECK(strings(third) == buffer);
+  REQUIRE_EQUAL(third->rows(), 2u);
+  CHECK_EQUAL(third->at(0, 0), data_view{caf::none});
+  CHECK_EQUAL(third->at(0, 1), make_data_view(count{2}));
+  CHECK_EQUAL(third->at(1, 0), make_data_view("qux"));
+  CHECK_EQUAL(third->at(1, 1), data_view{caf::none});
+}
+
+TEST(rebase) {
+  record_type layout{{"x", count_type{}}};
+  auto builder = default_table_slice_builder::make(layout);
+  for (count i = 0; i < 4; ++i)
+    REQUIRE(builder->add(make_view(i)));
+  auto slice = builder->finish();
+  REQUIRE_NOT_EQUAL(slice, nullptr);
+  MESSAGE("rebasing a shared slice leaves the original untouched");
+  auto shared = slice;
+  auto x = rebase(shared, 42);
+  CHECK_EQUAL(slice->offset(), 0u);
+  CHECK_EQUAL(x->offset(), 42u);
+  CHECK_EQUAL(x->implementation_id(), slice->implementation_id());
+  CHECK_EQUAL(*x, *slice);
+  MESSAGE("rebasing an unshared slice modifies it in place");
+  auto ptr = x.get();
+  auto y = rebase(std::move(x), 23);
+  CHECK(y.get() == ptr);
+  CHECK_EQUAL(y->offset(), 23u);
+  MESSAGE("serialization restores the original implementation");
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  REQUIRE_EQUAL(sink(y), caf::none);
+  table_slice_ptr z;
+  caf::binary_deserializer source{nullptr, buf};
+  REQUIRE_EQUAL(source(z), caf::none);
+  REQUIRE_NOT_EQUAL(z, nullptr);
+  CHECK_EQUAL(z->offset(), 23u);
+  CHECK_EQUAL(*z, *slice);
+}
+
+TEST(select and project share cells) {
+  record_type layout{{"x", count_type{}}, {"y", string_type{}}};
+  packed_table_slice_builder builder{layout};
+  for (count i = 0; i < 6; ++i) {
+    REQUIRE(builder.add(make_view(i)));
+    REQUIRE(builder.add(make_view(std::to_string(i))));
+  }
+  auto slice = builder.finish();
+  REQUIRE_NOT_EQUAL(slice, nullptr);
+  slice.unshared().offset(10);
+  auto roundtrip = [](table_slice_ptr x) {
+    std::vector<char> buf;
+    caf::binary_serializer sink{nullptr, buf};
+    REQUIRE_EQUAL(sink(x), caf::none);
+    table_slice_ptr result;
+    caf::binary_deserializer source{nullptr, buf};
+    REQUIRE_EQUAL(source(result), caf::none);
+    REQUIRE_NOT_EQUAL(result, nullptr);
+    return result;
+  };
+  MESSAGE("select one handle per contiguous run of IDs");
+  auto xs = select(slice, make_ids({{11, 13}, 14}));
+  REQUIRE_EQUAL(xs.size(), 2u);
+  CHECK_EQUAL(xs[0]->offset(), 11u);
+  CHECK_EQUAL(xs[0]->rows(), 2u);
+  CHECK_EQUAL(xs[1]->offset(), 14u);
+  CHECK_EQUAL(xs[1]->rows(), 1u);
+  CHECK_EQUAL(xs[0]->at(1, 0), make_data_view(count{2}));
+  CHECK_EQUAL(xs[1]->at(0, 1), make_data_view("4"));
+  CHECK_EQUAL(xs[0]->implementation_id(), packed_table_slice::class_id);
+  CHECK(!slice->unique());
+  MESSAGE("project the columns of a selection");
+  auto y = project(xs[0], {1});
+  REQUIRE_NOT_EQUAL(y, nullptr);
+  CHECK_EQUAL(y->columns(), 1u);
+  CHECK_EQUAL(y->offset(), 11u);
+  CHECK_EQUAL(y->at(0, 0), make_data_view("1"));
+  CHECK_EQUAL(y->at(1, 0), make_data_view("2"));
+  MESSAGE("serialization copies only the visible cells");
+  auto z = roundtrip(y);
+  CHECK_EQUAL(z->implementation_id(), packed_table_slice::class_id);
+  CHECK_EQUAL(z->offset(), 11u);
+  CHECK_EQUAL(*z, *y);
+  auto w = roundtrip(project(slice, {0}));
+  CHECK_EQUAL(w->rows(), 6u);
+  CHECK_EQUAL(w->columns(), 1u);
+  CHECK_EQUAL(w->at(5, 0), make_data_view(count{5}));
+}
+
+namespace {
+
+// Creates a default table slice with a mix of column types and values that
+// resemble a connection log.
+table_slice_ptr make_connection_slice(size_t rows) {
+  using namespace std::chrono;
+  record_type layout{
+    {"ts", timestamp_type{}},
+    {"orig_h", address_type{}},
+    {"orig_p", port_type{}},
+    {"proto", string_type{}},
+    {"bytes", count_type{}},
+    {"delta", integer_type{}},
+    {"duration", timespan_type{}},
+    {"score", real_type{}},
+  };
+  auto builder = default_table_slice_builder::make(layout);
+  auto protos = std::vector<std::string>{"tcp", "udp", "icmp"};
+  auto start = timestamp{} + hours{24 * 365 * 48};
+  for (size_t i = 0; i < rows; ++i) {
+    auto a = static_cast<uint32_t>(0x0a000000 + i % 256);
+    timestamp ts = start + milliseconds(3 * i);
+    REQUIRE(builder->add(make_view(ts)));
+    REQUIRE(builder->add(make_view(address{&a, address::ipv4, address::host})));
+    REQUIRE(builder->add(make_view(port{static_cast<port::number_type>(i),
+                                        port::tcp})));
+    REQUIRE(builder->add(make_view(protos[i % protos.size()])));
+    REQUIRE(builder->add(make_view(count{i * 17})));
+    REQUIRE(builder->add(make_view(integer{static_cast<integer>(i % 7) - 3})));
+    REQUIRE(builder->add(make_view(timespan{microseconds(i % 1000)})));
+    REQUIRE(builder->add(make_view(real{i / 3.0})));
+  }
+  return builder->finish();
+}
+
+} // namespace <anonymous>
+
+TEST(compact encoding) {
+  auto slice = make_connection_slice(1000);
+  REQUIRE_NOT_EQUAL(slice, nullptr);
+  auto impl = dynamic_cast<const default_table_slice*>(slice.get());
+  REQUIRE_NOT_EQUAL(impl, nullptr);
+  std::vector<char> generic;
+  caf::binary_serializer generic_sink{nullptr, generic};
+  REQUIRE_EQUAL(generic_sink(const_cast<vector&>(impl->container())),
+                caf::none);
+  std::vector<char> compact;
+  caf::binary_serializer compact_sink{nullptr, compact};
+  REQUIRE_EQUAL(slice->serialize(compact_sink), caf::none);
+  auto result = default_table_slice::make(slice->header());
+  caf::binary_deserializer source{nullptr, compact};
+  REQUIRE_EQUAL(result.unshared().deserialize(source), caf::none);
+  CHECK_EQUAL(*result, *slice);
+  CHECK_LESS(compact.size(), generic.size() / 2);
+}
+
+// Compares the compact encoding of default table slices with the generic
+// encoding of each cell, which default table slices used previously. Disabled
+// by default, since it measures rather than verifies.
+TEST_DISABLED(compact encoding benchmark) {
+  using namespace std::chrono;
+  auto slice = make_connection_slice(10000);
+  REQUIRE_NOT_EQUAL(slice, nullptr);
+  auto impl = dynamic_cast<const default_table_slice*>(slice.get());
+  REQUIRE_NOT_EQUAL(impl, nullptr);
+  auto& cells = impl->container();
+  constexpr int runs = 10;
+  auto measure = [&](auto f) {
+    auto first = steady_clock::now();
+    for (int i = 0; i < runs; ++i)
+      f();
+    return duration_cast<microseconds>(steady_clock::now() - first) / runs;
+  };
+  std::vector<char> generic;
+  auto generic_encode = measure([&] {
+    generic.clear();
+    caf::binary_serializer sink{nullptr, generic};
+    REQUIRE_EQUAL(sink(const_cast<vector&>(cells)), caf::none);
+  });
+  vector generic_result;
+  auto generic_decode = measure([&] {
+    caf::binary_deserializer source{nullptr, generic};
+    REQUIRE_EQUAL(source(generic_result), caf::none);
+  });
+  std::vector<char> compact;
+  auto compact_encode = measure([&] {
+    compact.clear();
+    caf::binary_serializer sink{nullptr, compact};
+    REQUIRE_EQUAL(slice->serialize(sink), caf::none);
+  });
+  auto compact_result = default_table_slice::make(slice->header());
+  auto compact_decode = measure([&] {
+    caf::binary_deserializer source{nullptr, compact};
+    REQUIRE_EQUAL(compact_result.unshared().deserialize(source), caf::none);
+  });
+  CHECK(generic_result == cells);
+  CHECK_EQUAL(*compact_result, *slice);
+  MESSAGE("generic encoding: " << generic.size() << " bytes, encode "
+          << generic_encode.count() << "us, decode "
+          << generic_decode.count() << "us");
+  MESSAGE("compact encoding: " << compact.size() << " bytes, encode "
+          << compact_encode.count() << "us, decode "
+          << compact_decode.count() << "us");
+  CHECK_LESS(compact.size(), generic.size() / 2);
+}
+
 FIXTURE_SCOPE_END()
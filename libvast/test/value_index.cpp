@@ -16,6 +16,7 @@
 #include "vast/test/test.hpp"
 #include "vast/test/fixtures/events.hpp"
 
+#include "vast/bitvector.hpp"
 #include "vast/value_index.hpp"
 #include "vast/value_index_factory.hpp"
 #include "vast/load.hpp"
@@ -251,6 +252,136 @@ TEST(string) {
   CHECK_EQUAL(to_string(unbox(result)), "0100010000");
 }
 
+TEST(string with trigrams) {
+  auto t = string_type{}.attributes({{"index", "trigram"}});
+  auto idx = factory<value_index>::make(t);
+  REQUIRE_NOT_EQUAL(idx, nullptr);
+  MESSAGE("append");
+  REQUIRE(idx->append(make_data_view("foobar")));
+  REQUIRE(idx->append(make_data_view("abcxbcd")));
+  REQUIRE(idx->append(make_data_view("abcd")));
+  REQUIRE(idx->append(make_data_view("xabcdx")));
+  REQUIRE(idx->append(make_data_view("ab")));
+  MESSAGE("lookup");
+  auto result = idx->lookup(ni, make_data_view("abc"));
+  CHECK_EQUAL(to_string(unbox(result)), "01110");
+  result = idx->lookup(ni, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "10000");
+  result = idx->lookup(ni, make_data_view("zzz"));
+  CHECK_EQUAL(to_string(unbox(result)), "00000");
+  MESSAGE("candidates with trigrams at different positions");
+  result = idx->lookup(ni, make_data_view("abcd"));
+  CHECK_EQUAL(to_string(unbox(result)), "00110");
+  result = idx->lookup(not_ni, make_data_view("abcd"));
+  CHECK_EQUAL(to_string(unbox(result)), "11001");
+  MESSAGE("substrings shorter than a trigram");
+  result = idx->lookup(ni, make_data_view("ab"));
+  CHECK_EQUAL(to_string(unbox(result)), "01111");
+  MESSAGE("serialization");
+  std::string buf;
+  CHECK_EQUAL(save(nullptr, buf, idx), caf::none);
+  value_index_ptr idx2;
+  REQUIRE_EQUAL(load(nullptr, buf, idx2), caf::none);
+  REQUIRE(idx2->append(make_data_view("xbcdx")));
+  result = idx2->lookup(ni, make_data_view("bcd"));
+  CHECK_EQUAL(to_string(unbox(result)), "011101");
+}
+
+// Indexes without trigrams must keep the layout that predates trigram
+// support: the value index state, the maximum string length, the length
+// index, and one index per character position.
+TEST(string index baseline format) {
+  using char_index = bitmap_index<uint8_t, bitslice_coder<ewah_bitmap>>;
+  using length_index =
+    bitmap_index<uint32_t, multi_level_coder<range_coder<ids>>>;
+  auto xs = std::vector<std::string>{"foo", "bar", "foobar"};
+  ewah_bitmap mask;
+  ewah_bitmap none;
+  size_t max_length = 1024;
+  length_index length{base::uniform(10, 4)};
+  std::vector<char_index> chars;
+  for (auto pos = 0u; pos < xs.size(); ++pos) {
+    auto& x = xs[pos];
+    for (auto i = 0u; i < x.size(); ++i) {
+      if (i == chars.size())
+        chars.emplace_back(8);
+      chars[i].skip(pos - chars[i].size());
+      chars[i].append(static_cast<uint8_t>(x[i]));
+    }
+    length.append(x.size());
+    mask.append_bit(true);
+  }
+  std::string buf;
+  auto t = type{string_type{}};
+  REQUIRE_EQUAL(save(nullptr, buf, t, mask, none, max_length, length, chars),
+                caf::none);
+  value_index_ptr idx;
+  REQUIRE_EQUAL(load(nullptr, buf, idx), caf::none);
+  REQUIRE_NOT_EQUAL(idx, nullptr);
+  auto result = idx->lookup(equal, make_data_view("foo"));
+  CHECK_EQUAL(to_string(unbox(result)), "100");
+  result = idx->lookup(equal, make_data_view("foobar"));
+  CHECK_EQUAL(to_string(unbox(result)), "001");
+  result = idx->lookup(not_equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "101");
+  MESSAGE("serialization retains the layout");
+  std::string copy;
+  CHECK_EQUAL(save(nullptr, copy, idx), caf::none);
+  CHECK_EQUAL(copy, buf);
+}
+
+TEST(string hash index) {
+  auto t = string_type{}.attributes({{"index", "hash"}});
+  auto idx = factory<value_index>::make(t);
+  REQUIRE_NOT_EQUAL(idx, nullptr);
+  MESSAGE("append");
+  REQUIRE(idx->append(make_data_view("foo")));
+  REQUIRE(idx->append(make_data_view("bar")));
+  REQUIRE(idx->append(make_data_view("foo")));
+  REQUIRE(idx->append(make_data_view("")));
+  REQUIRE(idx->append(make_data_view("foobar")));
+  MESSAGE("lookup");
+  auto result = idx->lookup(equal, make_data_view("foo"));
+  CHECK_EQUAL(to_string(unbox(result)), "10100");
+  result = idx->lookup(equal, make_data_view(""));
+  CHECK_EQUAL(to_string(unbox(result)), "00010");
+  result = idx->lookup(equal, make_data_view("baz"));
+  CHECK_EQUAL(to_string(unbox(result)), "00000");
+  result = idx->lookup(not_equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "10111");
+  result = idx->lookup(not_equal, make_data_view("baz"));
+  CHECK_EQUAL(to_string(unbox(result)), "11111");
+  auto xs = set{"foo", "foobar"};
+  result = idx->lookup(in, make_data_view(xs));
+  CHECK_EQUAL(to_string(unbox(result)), "10101");
+  result = idx->lookup(not_in, make_data_view(xs));
+  CHECK_EQUAL(to_string(unbox(result)), "01010");
+  MESSAGE("membership in large containers");
+  auto ys = vector{"foo", "bar", "", "foobar"};
+  for (auto i = 0; i < 40; ++i)
+    ys.emplace_back("baz" + std::to_string(i));
+  result = idx->lookup(in, make_data_view(ys));
+  CHECK_EQUAL(to_string(unbox(result)), "11111");
+  result = idx->lookup(not_in, make_data_view(ys));
+  CHECK_EQUAL(to_string(unbox(result)), "00000");
+  ys.erase(ys.begin() + 1);
+  result = idx->lookup(in, make_data_view(ys));
+  CHECK_EQUAL(to_string(unbox(result)), "10111");
+  result = idx->lookup(not_in, make_data_view(ys));
+  CHECK_EQUAL(to_string(unbox(result)), "01000");
+  MESSAGE("unsupported operators");
+  CHECK(!idx->lookup(ni, make_data_view("oo")));
+  CHECK(!idx->lookup(less, make_data_view("foo")));
+  MESSAGE("serialization");
+  std::string buf;
+  CHECK_EQUAL(save(nullptr, buf, idx), caf::none);
+  value_index_ptr idx2;
+  REQUIRE_EQUAL(load(nullptr, buf, idx2), caf::none);
+  REQUIRE(idx2->append(make_data_view("bar")));
+  result = idx2->lookup(equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "010001");
+}
+
 TEST(address) {
   address_index idx{address_type{}};
   MESSAGE("append");
@@ -496,6 +627,94 @@ TEST(none values) {
   CHECK_EQUAL(to_string(unbox(bm)), "01100011100001111111100");
 }
 
+TEST(batch append) {
+  MESSAGE("typed batch with gaps and nil values");
+  std::vector<integer> xs{42, 42, 42, 0, 7, 7, -1, 42};
+  bitvector<uint64_t> valid;
+  for (auto bit : {true, true, false, true, true, true, false, true})
+    valid.push_back(bit);
+  auto bulk = factory<value_index>::make(integer_type{});
+  auto single = factory<value_index>::make(integer_type{});
+  REQUIRE_NOT_EQUAL(bulk, nullptr);
+  REQUIRE_NOT_EQUAL(single, nullptr);
+  REQUIRE(bulk->append(make_data_view(integer{1}), 0));
+  REQUIRE(single->append(make_data_view(integer{1}), 0));
+  REQUIRE(bulk->append(column_batch{span<const integer>{xs}, &valid}, 2));
+  for (size_t i = 0; i < xs.size(); ++i) {
+    auto x = valid[i] ? make_data_view(xs[i]) : data_view{caf::none};
+    REQUIRE(single->append(x, 2 + i));
+  }
+  CHECK_EQUAL(bulk->offset(), single->offset());
+  for (auto op : {equal, not_equal, less, greater_equal})
+    for (auto x : {integer{42}, integer{7}, integer{0}, integer{-1}})
+      CHECK_EQUAL(to_string(unbox(bulk->lookup(op, make_data_view(x)))),
+                  to_string(unbox(single->lookup(op, make_data_view(x)))));
+  auto bm = bulk->lookup(equal, make_data_view(caf::none));
+  CHECK_EQUAL(to_string(unbox(bm)), "0000100010");
+  CHECK(!bulk->append(column_batch{span<const integer>{xs}}, 4));
+  MESSAGE("addresses and ports");
+  std::vector<address> addrs{*to<address>("10.0.0.1"),
+                             *to<address>("10.0.0.1"),
+                             *to<address>("10.0.0.2"),
+                             *to<address>("::1")};
+  std::vector<port> ports{port{80, port::tcp}, port{80, port::tcp},
+                          port{53, port::udp}, port{443, port::tcp}};
+  auto addr_idx = factory<value_index>::make(address_type{});
+  auto port_idx = factory<value_index>::make(port_type{});
+  REQUIRE_NOT_EQUAL(addr_idx, nullptr);
+  REQUIRE_NOT_EQUAL(port_idx, nullptr);
+  REQUIRE(addr_idx->append(column_batch{span<const address>{addrs}}, 0));
+  REQUIRE(port_idx->append(column_batch{span<const port>{ports}}, 0));
+  bm = addr_idx->lookup(equal, make_data_view(addrs[0]));
+  CHECK_EQUAL(to_string(unbox(bm)), "1100");
+  bm = addr_idx->lookup(not_equal, make_data_view(addrs[3]));
+  CHECK_EQUAL(to_string(unbox(bm)), "1110");
+  bm = port_idx->lookup(equal, make_data_view(port{80, port::tcp}));
+  CHECK_EQUAL(to_string(unbox(bm)), "1100");
+  bm = port_idx->lookup(greater, make_data_view(port{53, port::unknown}));
+  CHECK_EQUAL(to_string(unbox(bm)), "1101");
+  MESSAGE("generic batch");
+  auto str_idx = factory<value_index>::make(string_type{});
+  REQUIRE_NOT_EQUAL(str_idx, nullptr);
+  std::vector<data_view> strs{make_data_view("foo"), data_view{caf::none},
+                              make_data_view("bar"), make_data_view("foo")};
+  REQUIRE(str_idx->append(column_batch{strs}, 0));
+  bm = str_idx->lookup(equal, make_data_view("foo"));
+  CHECK_EQUAL(to_string(unbox(bm)), "1001");
+  bm = str_idx->lookup(equal, make_data_view(caf::none));
+  CHECK_EQUAL(to_string(unbox(bm)), "0100");
+}
+
+TEST(batch append with validity bitmap spanning multiple blocks) {
+  std::vector<count> xs;
+  bitvector<uint64_t> valid;
+  for (count i = 0; i < 200; ++i) {
+    xs.push_back(i % 5);
+    valid.push_back(i < 70 ? i % 3 != 0 : i < 140);
+  }
+  auto bulk = factory<value_index>::make(count_type{});
+  auto single = factory<value_index>::make(count_type{});
+  REQUIRE_NOT_EQUAL(bulk, nullptr);
+  REQUIRE_NOT_EQUAL(single, nullptr);
+  REQUIRE(bulk->append(column_batch{span<const count>{xs}, &valid}, 10));
+  for (size_t i = 0; i < xs.size(); ++i) {
+    auto x = valid[i] ? make_data_view(xs[i]) : data_view{caf::none};
+    REQUIRE(single->append(x, 10 + i));
+  }
+  CHECK_EQUAL(bulk->offset(), single->offset());
+  for (auto op : {equal, not_equal})
+    for (auto x : {data_view{caf::none}, make_data_view(count{3})})
+      CHECK_EQUAL(to_string(unbox(bulk->lookup(op, x))),
+                  to_string(unbox(single->lookup(op, x))));
+  MESSAGE("the bitmap takes precedence over the values");
+  std::vector<data_view> ys(xs.size(), make_data_view("foo"));
+  auto str_idx = factory<value_index>::make(string_type{});
+  REQUIRE_NOT_EQUAL(str_idx, nullptr);
+  REQUIRE(str_idx->append(column_batch{ys, &valid}, 10));
+  CHECK_EQUAL(to_string(unbox(str_idx->lookup(equal, data_view{caf::none}))),
+              to_string(unbox(single->lookup(equal, data_view{caf::none}))));
+}
+
 namespace {
 
 auto orig_h(const event& x) {
@@ -19,6 +19,7 @@
 #include "vast/bitmap_base.hpp"
 #include "vast/ewah_bitmap.hpp"
 #include "vast/null_bitmap.hpp"
+#include "vast/roaring_bitmap.hpp"
 #include "vast/wah_bitmap.hpp"
 
 #include "vast/detail/operators.hpp"
@@ -37,7 +38,8 @@ public:
   using types = caf::detail::type_list<
     ewah_bitmap,
     null_bitmap,
-    wah_bitmap
+    wah_bitmap,
+    roaring_bitmap
   >;
 
   using variant = caf::detail::tl_apply_t<types, caf::variant>;
@@ -85,6 +87,7 @@ public:
   variant& get_data();
   const variant& get_data() const;
 
+  /// Compares two bitmaps bit by bit, regardless of their concrete types.
   friend bool operator==(const bitmap& x, const bitmap& y);
 
   template <class Inspector>
@@ -109,7 +112,8 @@ private:
   using range_variant = caf::variant<
     ewah_bitmap_range,
     null_bitmap_range,
-    wah_bitmap_range
+    wah_bitmap_range,
+    roaring_bitmap_range
   >;
 
   range_variant range_;
@@ -117,6 +121,26 @@ private:
 
 bitmap_bit_range bit_range(const bitmap& bm);
 
+// -- bitwise operations -------------------------------------------------------
+
+// The following overloads use the specialized algorithms of ::ewah_bitmap if
+// both sides are EWAH bitmaps. If either side is a ::roaring_bitmap, they
+// convert the other side and produce a ::roaring_bitmap, so that a sparse ID
+// set keeps its representation when combined with the output of an index.
+// All other combinations fall back to ::binary_eval.
+
+/// @relates bitmap
+bitmap binary_and(const bitmap& lhs, const bitmap& rhs);
+
+/// @relates bitmap
+bitmap binary_or(const bitmap& lhs, const bitmap& rhs);
+
+/// @relates bitmap
+bitmap binary_xor(const bitmap& lhs, const bitmap& rhs);
+
+/// @relates bitmap
+bitmap binary_nand(const bitmap& lhs, const bitmap& rhs);
+
 } // namespace vast
 
 namespace caf {
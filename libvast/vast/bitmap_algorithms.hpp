@@ -14,9 +14,12 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
+#include <memory>
 #include <queue>
 #include <type_traits>
+#include <vector>
 
 #include <caf/error.hpp>
 
@@ -24,6 +27,7 @@
 #include "vast/bits.hpp"
 #include "vast/optional.hpp"
 #include "vast/detail/assert.hpp"
+#include "vast/detail/block_kernels.hpp"
 #include "vast/detail/range.hpp"
 #include "vast/detail/type_traits.hpp"
 
@@ -133,53 +137,417 @@ binary_eval(const LHS& lhs, const RHS& rhs, Operation op) {
   return result;
 }
 
-/// Evaluates a binary operation over multiple bitmaps.
-/// @param begin The beginning of the bitmap range.
-/// @param end The end of the bitmap range.
-/// @param op A binary bitwise operation to execute over the given bitmaps.
-/// @returns The application of *op* over the bitmaps *[begin,end)*.
-/// @note This algorithm is "Option 3" described in setion 5 in Wu et al.'s
-///       2004 paper titled *On the Performance of Bitmap Indices for
-///       High-Cardinality Attributes*.
-template <class Iterator, class Operation>
-auto nary_eval(Iterator begin, Iterator end, Operation op) {
+/// An operand of ::fold_eval.
+/// @relates fold_eval
+template <class Bitmap>
+struct bitmap_operand {
+  /// The bitmap.
+  const Bitmap* bitmap;
+
+  /// The operation that combines the bitmap with the result of all previous
+  /// operands. The operation of the first operand has no effect.
+  detail::block_operation op;
+
+  /// Whether to use the complement of the bitmap. Beyond its size, a negated
+  /// bitmap still consists of 0s, as if computed by `operator~`.
+  bool negate = false;
+};
+
+namespace detail {
+
+// Walks over the bit sequences of an operand of ::fold_eval.
+template <class Bitmap>
+class fold_cursor {
+public:
+  using bits_type = typename Bitmap::bits_type;
+  using size_type = typename Bitmap::size_type;
+  using word_type = typename Bitmap::word_type;
+
+  fold_cursor(const bitmap_operand<Bitmap>& x, block_operation op)
+    : range_{bit_range(*x.bitmap)},
+      op_{op},
+      negate_{x.negate} {
+    if (!range_.done())
+      bits_ = range_.get();
+  }
+
+  block_operation op() const {
+    return op_;
+  }
+
+  // The position of the current bit sequence.
+  size_type position() const {
+    return position_;
+  }
+
+  bool done() const {
+    return bits_.empty();
+  }
+
+  // An exhausted cursor behaves like an infinite run of 0s.
+  bool is_run() const {
+    return bits_.empty() || bits_.is_run() || bits_.homogeneous();
+  }
+
+  // The bit value of a run.
+  bool value() const {
+    return (data() & word_type::lsb1) != 0;
+  }
+
+  // Checks whether the current run determines the result of the operation.
+  bool absorbs() const {
+    if (!is_run())
+      return false;
+    switch (op_) {
+      case block_operation::and_op:
+        return !value();
+      case block_operation::or_op:
+      case block_operation::and_not_op:
+        return value();
+      default:
+        return false;
+    }
+  }
+
+  size_type size() const {
+    return bits_.empty() ? word_type::npos : bits_.size();
+  }
+
+  typename word_type::value_type data() const {
+    if (bits_.empty())
+      return word_type::none;
+    return negate_ ? ~bits_.data() : bits_.data();
+  }
+
+  void skip(size_type n) {
+    position_ += n;
+    while (n > 0 && !bits_.empty()) {
+      if (n < bits_.size()) {
+        bits_ = drop(bits_, n);
+        return;
+      }
+      n -= bits_.size();
+      range_.next();
+      bits_ = range_.done() ? bits_type{} : range_.get();
+    }
+  }
+
+  // Moves the cursor forward to a given position.
+  void skip_to(size_type pos) {
+    VAST_ASSERT(pos >= position_);
+    skip(pos - position_);
+  }
+
+private:
+  decltype(bit_range(std::declval<const Bitmap&>())) range_;
+  bits_type bits_;
+  size_type position_ = 0;
+  block_operation op_;
+  bool negate_;
+};
+
+// Estimates the cost of an operand of an n-ary operation, so that the
+// cheapest operands come first. For AND, the estimate is the number of
+// 1-bits, and for OR the number of 0-bits among the first *size* bits, i.e.,
+// the bits that do not determine the result. Starting with the operands
+// that have the fewest of them settles the intermediate results early. XOR
+// has no such bit, so its estimate is the number of bit sequences.
+template <class Bitmap>
+typename Bitmap::size_type
+operand_cost(const Bitmap& bm, block_operation op,
+             typename Bitmap::size_type size, bool negate = false) {
+  using size_type = typename Bitmap::size_type;
+  if (op == block_operation::and_op || op == block_operation::or_op) {
+    auto ones = rank<1>(bm);
+    if (negate)
+      ones = bm.size() - ones;
+    return op == block_operation::and_op ? ones : size - ones;
+  }
+  auto result = size_type{0};
+  for (auto r = bit_range(bm); !r.done(); r.next())
+    ++result;
+  return result;
+}
+
+// Implements ::fold_eval for the case where all operands have the same AND
+// or OR operation, i.e., where the order of operands does not matter. Only
+// operands with an inhomogeneous block at the current position participate
+// in computing the next block. The others wait in a queue ordered by the end
+// of their current run, unless the run determines the result, in which case
+// the algorithm skips to the end of the run.
+template <class Bitmap>
+Bitmap nary_fold(std::vector<fold_cursor<Bitmap>>& cursors,
+                 block_operation op, typename Bitmap::size_type size) {
+  using size_type = typename Bitmap::size_type;
+  using bits_type = typename Bitmap::bits_type;
+  using word_type = typename Bitmap::word_type;
+  VAST_ASSERT(op == block_operation::and_op || op == block_operation::or_op);
+  Bitmap result;
+  auto pos = size_type{0};
+  // The operands with a block at the current position.
+  std::vector<size_t> blocks;
+  // The operands in a run that determines the result, and the end of the
+  // longest such run.
+  std::vector<size_t> absorbers;
+  auto absorbed = size_type{0};
+  // The operands in runs that do not change the result, by end of their run.
+  using entry = std::pair<size_type, size_t>;
+  std::priority_queue<entry, std::vector<entry>, std::greater<>> runs;
+  auto classify = [&](size_t i) {
+    auto& x = cursors[i];
+    x.skip_to(pos);
+    if (x.absorbs()) {
+      absorbers.push_back(i);
+      absorbed = std::max(absorbed, x.done() ? size : pos + x.size());
+    } else if (!x.is_run())
+      blocks.push_back(i);
+    else if (!x.done())
+      runs.emplace(pos + x.size(), i);
+  };
+  // The operands to reclassify after moving past their current sequence.
+  std::vector<size_t> pending(cursors.size());
+  for (auto i = 0u; i < pending.size(); ++i)
+    pending[i] = i;
+  auto advance = [&] {
+    blocks.clear();
+    for (auto i : pending)
+      classify(i);
+    pending.clear();
+    while (!runs.empty() && runs.top().first <= pos) {
+      auto i = runs.top().second;
+      runs.pop();
+      classify(i);
+    }
+  };
+  advance();
+  while (pos < size) {
+    if (absorbed > pos) {
+      auto n = std::min(absorbed, size) - pos;
+      result.append_bits(op == block_operation::or_op, n);
+      pos += n;
+      // Operands in a run beyond the current position stay in the queue. All
+      // others need to catch up.
+      pending.swap(blocks);
+      pending.insert(pending.end(), absorbers.begin(), absorbers.end());
+      absorbers.clear();
+      advance();
+      continue;
+    }
+    auto end = runs.empty() ? size : std::min(size, runs.top().first);
+    auto data = op == block_operation::or_op ? word_type::none
+                                             : word_type::all;
+    for (auto i : blocks) {
+      end = std::min(end, pos + cursors[i].size());
+      data = combine(op, data, cursors[i].data());
+    }
+    auto n = end - pos;
+    result.append(bits_type{data, n});
+    pos += n;
+    pending.swap(blocks);
+    advance();
+  }
+  return result;
+}
+
+} // namespace detail
+
+/// Evaluates a left fold of bitwise operations over multiple bitmaps in a
+/// single pass, i.e., without materializing intermediate results. The
+/// algorithm walks the bit sequences of all operands at once. When the last
+/// operands consist of runs and one of them determines the result, e.g., a
+/// run of 0s under AND, it skips the corresponding bits of all operands
+/// before it. If all operations but the first are the same AND or OR, the
+/// order of the operands does not matter: the algorithm then skips over runs
+/// that determine the result in any operand and only combines the blocks of
+/// operands that are not inside a run, beginning with the operands that have
+/// the fewest bits that do not determine the result.
+/// @param xs The operands.
+/// @returns The application of the operations in *xs* from left to right,
+///          with shorter bitmaps padded with 0s.
+/// @relates bitmap_operand
+template <class Bitmap>
+Bitmap fold_eval(const std::vector<bitmap_operand<Bitmap>>& xs) {
+  using cursor = detail::fold_cursor<Bitmap>;
+  using size_type = typename Bitmap::size_type;
+  using bits_type = typename Bitmap::bits_type;
+  using detail::block_operation;
+  if (xs.empty())
+    return {};
+  auto size = size_type{0};
+  for (auto& x : xs)
+    size = std::max(size, x.bitmap->size());
+  // If all operations are the same AND or OR, we can reorder the operands.
+  auto common = xs.back().op;
+  auto commutative = (common == block_operation::and_op
+                      || common == block_operation::or_op)
+                     && std::all_of(xs.begin() + 1, xs.end(), [&](auto& x) {
+                          return x.op == common;
+                        });
+  std::vector<cursor> cursors;
+  cursors.reserve(xs.size());
+  if (commutative) {
+    std::vector<std::pair<size_type, size_t>> order;
+    order.reserve(xs.size());
+    for (auto i = 0u; i < xs.size(); ++i) {
+      auto& x = xs[i];
+      auto cost = detail::operand_cost(*x.bitmap, common, size, x.negate);
+      order.emplace_back(cost, i);
+    }
+    std::sort(order.begin(), order.end());
+    for (auto& entry : order)
+      cursors.emplace_back(xs[entry.second], common);
+    return detail::nary_fold(cursors, common, size);
+  }
+  for (auto& x : xs)
+    cursors.emplace_back(x, x.op);
+  Bitmap result;
+  // Appends a run to the result and advances all operands accordingly.
+  auto emit = [&](bool bit, size_type n) {
+    result.append_bits(bit, n);
+    for (auto& x : cursors)
+      x.skip(n);
+  };
+  while (result.size() < size) {
+    auto remaining = size - result.size();
+    // Walk backwards over the trailing runs, which either leave the result
+    // of the previous operands unchanged, flip it, or determine it.
+    auto n = remaining;
+    auto flip = false;
+    auto found = false;
+    for (auto i = cursors.size(); i-- > 0 && cursors[i].is_run();) {
+      n = std::min(n, cursors[i].size());
+      auto bit = cursors[i].value();
+      if (i == 0 || cursors[i].absorbs()) {
+        if (i > 0)
+          bit = cursors[i].op() == block_operation::or_op;
+        emit(bit != flip, n);
+        found = true;
+        break;
+      }
+      if (cursors[i].op() == block_operation::xor_op && bit)
+        flip = !flip;
+    }
+    if (found)
+      continue;
+    // Combine the next bits of all operands. Unless all operands consist of
+    // runs at this point, this processes at most one block.
+    n = remaining;
+    for (auto& x : cursors)
+      n = std::min(n, x.size());
+    auto data = cursors[0].data();
+    for (auto i = 1u; i < cursors.size(); ++i)
+      data = detail::combine(cursors[i].op(), data, cursors[i].data());
+    result.append(bits_type{data, n});
+    for (auto& x : cursors)
+      x.skip(n);
+  }
+  return result;
+}
+
+namespace detail {
+
+// Evaluates an AND, OR, or XOR over multiple bitmaps by repeatedly combining
+// the two bitmaps with the lowest ::operand_cost with the binary operation of
+// the bitmap type. This is "Option 3" described in section 5 in Wu et al.'s
+// 2004 paper titled *On the Performance of Bitmap Indices for
+// High-Cardinality Attributes*, which orders by size instead.
+template <class Iterator>
+auto pairwise_eval(Iterator begin, Iterator end, block_operation op) {
   using bitmap_type = std::decay_t<decltype(*begin)>;
+  using size_type = typename bitmap_type::size_type;
+  auto size = size_type{0};
+  for (auto i = begin; i != end; ++i)
+    size = std::max(size, i->size());
   // Exposes a pointer to represent either a non-owned bitmap from the input
   // sequence or an intermediary result.
   struct element {
-    explicit element(const bitmap_type* bm) : bitmap{bm} {
+    element(const bitmap_type* bm, size_type cost) : bitmap{bm}, cost{cost} {
     }
-    explicit element(bitmap_type&& bm)
+    element(bitmap_type&& bm, size_type cost)
       : data{std::make_shared<bitmap_type>(std::move(bm))},
-        bitmap{data.get()} {
+        bitmap{data.get()},
+        cost{cost} {
     }
     std::shared_ptr<bitmap_type> data;
     const bitmap_type* bitmap;
+    size_type cost;
   };
   auto cmp = [](auto& lhs, auto& rhs) {
-    // TODO: instead of using the bitmap size, we should consider whether
-    // the rank yields better performance.
-    return lhs.bitmap->size() > rhs.bitmap->size();
+    return lhs.cost > rhs.cost;
+  };
+  auto apply = [op](const bitmap_type& lhs, const bitmap_type& rhs) {
+    switch (op) {
+      case block_operation::and_op:
+        return lhs & rhs;
+      case block_operation::or_op:
+        return lhs | rhs;
+      default:
+        return lhs ^ rhs;
+    }
   };
   std::priority_queue<element, std::vector<element>, decltype(cmp)> queue{cmp};
   for (; begin != end; ++begin)
-    queue.emplace(&*begin);
-  // Evaluate bitmaps.
+    queue.emplace(&*begin, operand_cost(*begin, op, size));
   while (!queue.empty()) {
     auto lhs = queue.top();
     queue.pop();
     if (queue.empty())
-      // When our input sequence consists of a single bitmap, we end up with an
-      // element that has no data. Otherwise we would have had a least one
-      // intermediary result, which would be stored as data.
       return lhs.data ? std::move(*lhs.data) : *lhs.bitmap;
     auto rhs = queue.top();
     queue.pop();
-    queue.emplace(op(*lhs.bitmap, *rhs.bitmap));
+    auto x = apply(*lhs.bitmap, *rhs.bitmap);
+    auto cost = operand_cost(x, op, size);
+    queue.emplace(std::move(x), cost);
   }
   return bitmap_type{};
 }
 
+// Checks whether the bitmaps in *[begin,end)* consist of long enough bit
+// sequences on average for ::fold_eval to outperform ::pairwise_eval. The
+// single-pass evaluation skips runs cheaply, but pays more per block than
+// the specialized binary operations.
+template <class Iterator>
+bool has_long_sequences(Iterator begin, Iterator end) {
+  constexpr size_t min_average_length = 512;
+  size_t budget = 0;
+  for (auto i = begin; i != end; ++i)
+    budget += i->size() / min_average_length;
+  // Stop counting as soon as the sequences are too short on average.
+  size_t sequences = 0;
+  for (; begin != end; ++begin)
+    for (auto r = bit_range(*begin); !r.done(); r.next())
+      if (++sequences > budget)
+        return false;
+  return true;
+}
+
+} // namespace detail
+
+/// Evaluates a bitwise operation over multiple bitmaps. For more than a few
+/// bitmaps that consist mostly of runs, the evaluation takes a single pass
+/// over all bitmaps via ::fold_eval. Otherwise, it combines pairs of bitmaps
+/// with the binary operation of the bitmap type, which processes blocks
+/// faster.
+/// @param begin The beginning of the bitmap range.
+/// @param end The end of the bitmap range.
+/// @param op The AND, OR, or XOR operation to apply to all bitmaps in
+///           *[begin,end)*.
+/// @returns The application of *op* over the bitmaps *[begin,end)*.
+/// @relates fold_eval
+template <class Iterator>
+auto nary_eval(Iterator begin, Iterator end, detail::block_operation op) {
+  using bitmap_type = std::decay_t<decltype(*begin)>;
+  VAST_ASSERT(op != detail::block_operation::and_not_op);
+  constexpr auto max_pairwise_fan_in = 4;
+  if (std::distance(begin, end) <= max_pairwise_fan_in
+      || !detail::has_long_sequences(begin, end))
+    return detail::pairwise_eval(begin, end, op);
+  std::vector<bitmap_operand<bitmap_type>> xs;
+  for (; begin != end; ++begin)
+    xs.push_back({&*begin, op});
+  return fold_eval(xs);
+}
+
 template <class LHS, class RHS>
 auto binary_and(const LHS& lhs, const RHS& rhs) {
   auto op = [](auto x, auto y) { return x & y; };
@@ -212,20 +580,17 @@ auto binary_nor(const LHS& lhs, const RHS& rhs) {
 
 template <class Iterator>
 auto nary_and(Iterator begin, Iterator end) {
-  auto op = [](auto x, auto y) { return x & y; };
-  return nary_eval(begin, end, op);
+  return nary_eval(begin, end, detail::block_operation::and_op);
 }
 
 template <class Iterator>
 auto nary_or(Iterator begin, Iterator end) {
-  auto op = [](auto x, auto y) { return x | y; };
-  return nary_eval(begin, end, op);
+  return nary_eval(begin, end, detail::block_operation::or_op);
 }
 
 template <class Iterator>
 auto nary_xor(Iterator begin, Iterator end) {
-  auto op = [](auto x, auto y) { return x ^ y; };
-  return nary_eval(begin, end, op);
+  return nary_eval(begin, end, detail::block_operation::xor_op);
 }
 
 /// Computes the *rank* of a Bitmap, i.e., the number of occurrences of a bit
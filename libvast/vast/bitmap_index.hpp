@@ -68,6 +68,25 @@ public:
     coder_.encode(transform(binner_type::bin(x)), n);
   }
 
+  /// Appends a sequence of values. Consecutive values that fall into the same
+  /// bin become a single run, which the coder encodes at once.
+  /// @param first An iterator to the first element.
+  /// @param last An iterator one past the last element.
+  /// @param f Maps an element to the value to append.
+  template <class Iterator, class F>
+  void append(Iterator first, Iterator last, F f) {
+    auto bin = [&] {
+      return transform(binner_type::bin(static_cast<value_type>(f(*first))));
+    };
+    while (first != last) {
+      auto x = bin();
+      size_type n = 1;
+      while (++first != last && bin() == x)
+        ++n;
+      coder_.encode(x, n);
+    }
+  }
+
   /// Appends the contents of another bitmap index to this one.
   /// @param other The other bitmap index.
   void append(const bitmap_index& other) {
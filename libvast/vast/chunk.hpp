@@ -131,7 +131,7 @@ public:
   /// @param length The length of the slice, beginning at *start*. If 0, the
   ///               slice ranges from *start* to the end of the chunk.
   /// @returns A new chunk over the subset.
-  /// @pre `start + length < size()`
+  /// @pre `start < size() && start + length <= size()`
   chunk_ptr slice(size_type start, size_type length = 0) const;
 
 private:
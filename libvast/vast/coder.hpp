@@ -23,6 +23,7 @@
 #include <caf/meta/save_callback.hpp>
 
 #include "vast/base.hpp"
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/operator.hpp"
 #include "vast/detail/assert.hpp"
 #include "vast/detail/operators.hpp"
@@ -341,16 +342,16 @@ public:
         return bitmap_at(x);
       }
       case equal: {
-        auto result = bitmap_at(x);
-        if (x > 0)
-          result &= ~bitmap_at(x - 1);
-        return result;
+        if (x == 0)
+          return bitmap_at(x);
+        return bitmap_at(x) - bitmap_at(x - 1);
       }
       case not_equal: {
-        auto result = ~bitmap_at(x);
-        if (x > 0)
-          result |= bitmap_at(x - 1);
-        return result;
+        if (x == 0)
+          return ~bitmap_at(x);
+        using detail::block_operation;
+        return fold_eval<Bitmap>({{&bitmap_at(x), block_operation::or_op, true},
+                                  {&bitmap_at(x - 1), block_operation::or_op}});
       }
       case greater: {
         return ~bitmap_at(x);
@@ -424,23 +425,32 @@ public:
         } else if (op == less || op == greater_equal) {
           --x;
         }
-        auto result = x & 1 ? Bitmap{this->size_, true} : this->bitmaps_[0];
+        using detail::block_operation;
+        auto ones = Bitmap{this->size_, true};
+        std::vector<bitmap_operand<Bitmap>> xs;
+        xs.reserve(this->bitmaps_.size());
+        xs.push_back({x & 1 ? &ones : &this->bitmaps_[0],
+                      block_operation::and_op});
         for (auto i = 1u; i < this->bitmaps_.size(); ++i)
-          if ((x >> i) & 1)
-            result |= this->bitmaps_[i];
-          else
-            result &= this->bitmaps_[i];
+          xs.push_back({&this->bitmaps_[i], (x >> i) & 1
+                                              ? block_operation::or_op
+                                              : block_operation::and_op});
+        auto result = fold_eval(xs);
         if (op == greater || op == greater_equal || op == not_equal)
           result.flip();
         return result;
       }
       case equal:
       case not_equal: {
-        auto result = Bitmap{this->size_, true};
-        for (auto i = 0u; i < this->bitmaps_.size(); ++i) {
-          auto& bm = this->bitmaps_[i];
-          result &= (((x >> i) & 1) ? ~bm : bm);
-        }
+        using detail::block_operation;
+        auto ones = Bitmap{this->size_, true};
+        std::vector<bitmap_operand<Bitmap>> xs;
+        xs.reserve(this->bitmaps_.size() + 1);
+        xs.push_back({&ones, block_operation::and_op});
+        for (auto i = 0u; i < this->bitmaps_.size(); ++i)
+          xs.push_back({&this->bitmaps_[i], block_operation::and_op,
+                        ((x >> i) & 1) == 1});
+        auto result = fold_eval(xs);
         if (op == not_equal)
           result.flip();
         return result;
@@ -450,10 +460,14 @@ public:
         if (x == 0)
           break;
         x = ~x;
-        auto result = Bitmap{this->size_, false};
+        using detail::block_operation;
+        auto zeros = Bitmap{this->size_, false};
+        std::vector<bitmap_operand<Bitmap>> xs;
+        xs.push_back({&zeros, block_operation::or_op});
         for (auto i = 0u; i < this->bitmaps_.size(); ++i)
           if (((x >> i) & 1) == 0)
-            result |= this->bitmaps_[i];
+            xs.push_back({&this->bitmaps_[i], block_operation::or_op});
+        auto result = fold_eval(xs);
         if (op == in)
           result.flip();
         return result;
@@ -606,10 +620,20 @@ private:
       --x;
     }
     base_.decompose(x, xs_);
-    bitmap_type result{size(), true};
-    auto get_bitmap = [&](size_t coder_index, size_t bitmap_index) -> auto& {
-      return coders[coder_index].bitmap_at(bitmap_index);
+    using detail::block_operation;
+    auto and_op = block_operation::and_op;
+    auto or_op = block_operation::or_op;
+    bitmap_type ones{size(), true};
+    auto get_bitmap = [&](size_t coder_index, size_t bitmap_index) {
+      return &coders[coder_index].bitmap_at(bitmap_index);
     };
+    // Evaluate the chain of operations over all components in a single pass.
+    std::vector<bitmap_operand<bitmap_type>> operands;
+    operands.reserve(2 * base_.size());
+    operands.push_back({&ones, and_op});
+    // Holds the XOR of adjacent bitmaps for equality.
+    std::vector<bitmap_type> xors;
+    xors.reserve(base_.size());
     switch (op) {
       default:
         return bitmap_type{size(), false};
@@ -618,26 +642,29 @@ private:
       case greater:
       case greater_equal: {
         if (xs_[0] < base_[0] - 1) // && bitmap != all_ones
-          result = get_bitmap(0, xs_[0]);
+          operands[0].bitmap = get_bitmap(0, xs_[0]);
         for (auto i = 1u; i < base_.size(); ++i) {
           if (xs_[i] != base_[i] - 1) // && bitmap != all_ones
-            result &= get_bitmap(i, xs_[i]);
+            operands.push_back({get_bitmap(i, xs_[i]), and_op});
           if (xs_[i] != 0) // && bitmap != all_ones
-            result |= get_bitmap(i, xs_[i] - 1);
+            operands.push_back({get_bitmap(i, xs_[i] - 1), or_op});
         }
       } break;
       case equal:
       case not_equal: {
         for (auto i = 0u; i < base_.size(); ++i) {
-          if (xs_[i] == 0) // && bitmap != all_ones
-            result &= get_bitmap(i, 0);
-          else if (xs_[i] == base_[i] - 1)
-            result &= ~get_bitmap(i, base_[i] - 2);
-          else
-            result &= get_bitmap(i, xs_[i]) ^ get_bitmap(i, xs_[i] - 1);
+          if (xs_[i] == 0) { // && bitmap != all_ones
+            operands.push_back({get_bitmap(i, 0), and_op});
+          } else if (xs_[i] == base_[i] - 1) {
+            operands.push_back({get_bitmap(i, base_[i] - 2), and_op, true});
+          } else {
+            xors.push_back(*get_bitmap(i, xs_[i]) ^ *get_bitmap(i, xs_[i] - 1));
+            operands.push_back({&xors.back(), and_op});
+          }
         }
       } break;
     }
+    auto result = fold_eval(operands);
     if (op == greater || op == greater_equal || op == not_equal)
       result.flip();
     return result;
@@ -654,9 +681,11 @@ private:
   > {
     VAST_ASSERT(op == equal || op == not_equal);
     base_.decompose(x, xs_);
-    auto result = coders[0].decode(equal, xs_[0]);
-    for (auto i = 1u; i < base_.size(); ++i)
-      result &= coders[i].decode(equal, xs_[i]);
+    std::vector<bitmap_type> xs;
+    xs.reserve(base_.size());
+    for (auto i = 0u; i < base_.size(); ++i)
+      xs.push_back(coders[i].decode(equal, xs_[i]));
+    auto result = nary_and(xs.begin(), xs.end());
     if (op == not_equal || op == not_in)
       result.flip();
     return result;
@@ -0,0 +1,169 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <caf/atom.hpp>
+#include <caf/variant.hpp>
+
+#include "vast/address.hpp"
+#include "vast/aliases.hpp"
+#include "vast/bitvector.hpp"
+#include "vast/data.hpp"
+#include "vast/detail/object_pool.hpp"
+#include "vast/fwd.hpp"
+#include "vast/port.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/time.hpp"
+#include "vast/view.hpp"
+
+namespace vast {
+
+/// A table slice that stores each column contiguously. Columns of basic types
+/// hold their values in a typed array, strings share a single byte buffer
+/// with one offset per row, and all remaining types use the cell encoding of
+/// @ref packed_table_slice in a single byte buffer. A validity bitmap per
+/// column marks the rows that hold a value, and the typed array keeps a
+/// default-constructed placeholder for nil cells. Since variable-length
+/// values never live in individual heap objects, building and destroying a
+/// slice costs a handful of allocations per column rather than one per cell.
+class columnar_table_slice final : public table_slice {
+public:
+  // -- friends ----------------------------------------------------------------
+
+  friend class columnar_table_slice_builder;
+
+  // -- member types -----------------------------------------------------------
+
+  /// The values of a string column in a single buffer.
+  struct string_array {
+    /// The end offset of each string in `bytes`.
+    std::vector<uint64_t> offsets;
+
+    /// The concatenated strings.
+    std::string bytes;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, string_array& x) {
+      return f(x.offsets, x.bytes);
+    }
+  };
+
+  /// The encoded values of a column of any other type in a single buffer.
+  struct encoded_array {
+    /// The end offset of each encoded value in `bytes`.
+    std::vector<uint64_t> offsets;
+
+    /// The concatenated encoded values.
+    std::vector<char> bytes;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, encoded_array& x) {
+      return f(x.offsets, x.bytes);
+    }
+  };
+
+  /// The typed storage of a column. Booleans use one byte per value.
+  using array = caf::variant<
+    std::vector<uint8_t>,
+    std::vector<integer>,
+    std::vector<count>,
+    std::vector<real>,
+    std::vector<timespan>,
+    std::vector<timestamp>,
+    std::vector<port>,
+    std::vector<address>,
+    string_array,
+    encoded_array
+  >;
+
+  /// A single column.
+  struct column {
+    /// Has a bit set for every row that holds a value.
+    bitvector<uint64_t> valid;
+
+    /// The values of the column, including placeholders for nil cells.
+    array values;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, column& x) {
+      return f(x.valid, x.values);
+    }
+  };
+
+  /// Recycles the columns of destroyed slices. A released container holds
+  /// empty columns that keep their allocated storage.
+  using pool_type = detail::object_pool<std::vector<column>>;
+
+  // -- constants --------------------------------------------------------------
+
+  static constexpr caf::atom_value class_id = caf::atom("columnar");
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  ~columnar_table_slice() override;
+
+  // -- static factory functions -----------------------------------------------
+
+  static table_slice_ptr make(table_slice_header header);
+
+  /// Creates an empty array suitable for values of type *t*.
+  static array make_array(const type& t);
+
+  // -- factory functions ------------------------------------------------------
+
+  columnar_table_slice* copy() const final;
+
+  // -- persistence ------------------------------------------------------------
+
+  caf::error serialize(caf::serializer& sink) const final;
+
+  caf::error deserialize(caf::deserializer& source) final;
+
+  // -- visitation -------------------------------------------------------------
+
+  /// Applies all values in column `col` to `idx`.
+  void append_column_to_index(size_type col, value_index& idx) const final;
+
+  // -- properties -------------------------------------------------------------
+
+  data_view at(size_type row, size_type col) const final;
+
+  caf::atom_value implementation_id() const noexcept final;
+
+  /// @returns the columns of the slice.
+  const std::vector<column>& columns_data() const noexcept {
+    return columns_;
+  }
+
+private:
+  // -- constructors, destructors, and assignment operators --------------------
+
+  explicit columnar_table_slice(table_slice_header header);
+
+  // -- member variables -------------------------------------------------------
+
+  std::vector<column> columns_;
+
+  /// Receives `columns_` on destruction if set.
+  caf::intrusive_ptr<pool_type> pool_;
+};
+
+/// @relates columnar_table_slice
+using columnar_table_slice_ptr = caf::intrusive_cow_ptr<columnar_table_slice>;
+
+} // namespace vast
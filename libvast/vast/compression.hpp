@@ -65,5 +65,32 @@ bool uncompress(const char* in, size_t in_size, char* out);
 } // namespace snappy
 #endif // VAST_SNAPPY
 
+/// @returns an upper bound for the compressed output.
+/// @param method The compression method.
+/// @param size The size of the uncompressed input.
+size_t compress_bound(compression method, size_t size);
+
+/// Compresses a contiguous byte sequence with a given method.
+/// @param method The compression method.
+/// @param in The uncompressed input.
+/// @param in_size The size of *in*.
+/// @param out The output buffer of at least `compress_bound(method, in_size)`
+///            bytes.
+/// @param out_size The size of *out*.
+/// @returns The number of bytes written to *out* or 0 on failure.
+size_t compress(compression method, const char* in, size_t in_size, char* out,
+                size_t out_size);
+
+/// Uncompresses a contiguous byte sequence with a given method.
+/// @param method The compression method.
+/// @param in The compressed input.
+/// @param in_size The size of *in*.
+/// @param out The output buffer.
+/// @param out_size The size of *out*, which must match the size of the
+///                 uncompressed data exactly.
+/// @returns `true` on success.
+bool uncompress(compression method, const char* in, size_t in_size, char* out,
+                size_t out_size);
+
 } // namespace vast
 
@@ -19,6 +19,7 @@
 
 #include "vast/aliases.hpp"
 #include "vast/data.hpp"
+#include "vast/detail/object_pool.hpp"
 #include "vast/fwd.hpp"
 #include "vast/table_slice.hpp"
 
@@ -35,6 +36,16 @@ public:
 
   static constexpr caf::atom_value class_id = caf::atom("default");
 
+  // -- member types -----------------------------------------------------------
+
+  /// Recycles the rows of destroyed slices. A released container keeps its
+  /// row vectors, but all cells are nil.
+  using pool_type = detail::object_pool<vector>;
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  ~default_table_slice() override;
+
   // -- static factory functions -----------------------------------------------
 
   static table_slice_ptr make(table_slice_header header);
@@ -73,6 +84,9 @@ protected:
 
 private:
   vector xs_;
+
+  /// Receives `xs_` on destruction if set.
+  caf::intrusive_ptr<pool_type> pool_;
 };
 
 /// @relates default_table_slice
@@ -63,6 +63,13 @@ protected:
   std::vector<data> row_;
   size_t col_;
   std::unique_ptr<default_table_slice> slice_;
+
+  /// The number of complete rows in `slice_`. The container of `slice_` may
+  /// hold more rows when it comes from `pool_`, which get overridden first.
+  size_t rows_ = 0;
+
+  /// Recycles the rows of finished slices.
+  caf::intrusive_ptr<default_table_slice::pool_type> pool_;
 };
 
 } // namespace vast
@@ -85,12 +85,20 @@ caf::atom_value table_slice_type(caf::actor_system& sys,
 
 namespace system {
 
-/// The default table slice type.
+/// The default table slice type. Sources use columnar slices, because their
+/// builders keep variable-length values in a few buffers per column instead
+/// of allocating each cell separately.
 extern caf::atom_value table_slice_type;
 
-/// Maximum size for sources that generate table slices.
+/// Number of rows per table slice with which sources start.
 extern size_t table_slice_size;
 
+/// Maximum number of rows per table slice at sources.
+extern size_t table_slice_max_size;
+
+/// Time within which sources aim to fill a table slice.
+extern std::chrono::milliseconds table_slice_deadline;
+
 /// Maximum number of events per INDEX partition.
 extern size_t max_partition_size;
 
@@ -109,6 +117,25 @@ extern size_t segments;
 /// Maximum size of ARCHIVE segments in MB.
 extern size_t max_segment_size;
 
+/// Compression method for table slices in ARCHIVE segments.
+extern caf::atom_value segment_compression;
+
+/// Whether ARCHIVE segments store table slices column by column.
+extern bool columnar_segments;
+
+/// Whether ARCHIVE segments dictionary-encode low-cardinality string columns.
+extern bool dictionary_encoding;
+
+/// Maximum number of full ARCHIVE segments waiting to be written to disk.
+extern size_t max_pending_segments;
+
+/// Maximum number of ARCHIVE segments that a lookup loads concurrently.
+extern size_t extract_workers;
+
+/// Maximum number of bytes of ARCHIVE segments that a lookup loads
+/// concurrently.
+extern size_t max_extract_bytes;
+
 /// Number of initial IDs to request in the IMPORTER.
 extern size_t initially_requested_ids;
 
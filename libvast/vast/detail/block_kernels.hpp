@@ -0,0 +1,92 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vast::detail {
+
+/// The bitwise operations on blocks.
+enum class block_operation { and_op, or_op, xor_op, and_not_op };
+
+/// Applies a bitwise operation to two blocks.
+/// @param op The operation.
+/// @param x The left-hand side.
+/// @param y The right-hand side.
+/// @returns the result of *op* on *x* and *y*.
+constexpr uint64_t combine(block_operation op, uint64_t x, uint64_t y) {
+  switch (op) {
+    case block_operation::and_op:
+      return x & y;
+    case block_operation::or_op:
+      return x | y;
+    case block_operation::xor_op:
+      return x ^ y;
+    case block_operation::and_not_op:
+      return x & ~y;
+  }
+  return 0;
+}
+
+/// Combines two arrays of blocks element-wise into a third array.
+/// @param xs The blocks of the left-hand side.
+/// @param ys The blocks of the right-hand side.
+/// @param out The array receiving the result, which may alias *xs* or *ys*.
+/// @param n The number of blocks in each array.
+using block_kernel = void (*)(const uint64_t* xs, const uint64_t* ys,
+                              uint64_t* out, size_t n);
+
+/// A set of kernels for the bitwise operations on arrays of blocks.
+struct block_kernels {
+  /// Computes `xs & ys`.
+  block_kernel and_;
+
+  /// Computes `xs | ys`.
+  block_kernel or_;
+
+  /// Computes `xs ^ ys`.
+  block_kernel xor_;
+
+  /// Computes `xs & ~ys`.
+  block_kernel and_not;
+
+  /// The name of the instruction set.
+  const char* name;
+
+  /// @returns the kernel for *op*.
+  block_kernel operator[](block_operation op) const {
+    switch (op) {
+      case block_operation::and_op:
+        return and_;
+      case block_operation::or_op:
+        return or_;
+      case block_operation::xor_op:
+        return xor_;
+      case block_operation::and_not_op:
+        return and_not;
+    }
+    return nullptr;
+  }
+};
+
+/// @returns kernels that process one block at a time.
+const block_kernels& scalar_block_kernels();
+
+/// @returns the kernels for the widest vector instruction set that the CPU
+///          supports, which the function detects on its first invocation.
+///          Falls back to ::scalar_block_kernels on other architectures.
+const block_kernels& simd_block_kernels();
+
+} // namespace vast::detail
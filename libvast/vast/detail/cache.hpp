@@ -14,6 +14,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <unordered_map>
@@ -266,5 +267,244 @@ struct mru {
   }
 };
 
+/// Hit, miss, and eviction counters of a cache.
+struct cache_statistics {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+/// A cache that bounds the total weight of its values, e.g., their size in
+/// bytes, and evicts according to the *2Q* policy (Johnson and Shasha, 1994).
+/// New entries enter a FIFO queue *A1in*. Only entries that get requested
+/// again after falling out of *A1in* make it into the LRU queue *Am*. The
+/// cache remembers the keys of entries evicted from *A1in* in the ghost
+/// queue *A1out*. This way, a single scan over many entries cannot push the
+/// frequently used ones out of the cache.
+/// @tparam Weigher A function object that maps a value to its weight.
+template <class Key, class Value, class Weigher>
+class two_queue_cache {
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using weigher = Weigher;
+
+  /// Constructs a cache with a maximum total weight.
+  /// @param capacity The maximum total weight of all values.
+  /// @param f The function to compute the weight of a value.
+  /// @pre `capacity > 0`
+  explicit two_queue_cache(size_t capacity, weigher f = {})
+    : capacity_{capacity}, weigher_{std::move(f)} {
+    VAST_ASSERT(capacity_ > 0);
+  }
+
+  // -- capacity -------------------------------------------------------------
+
+  /// @returns The maximum total weight of all values.
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /// @returns The total weight of all values in the cache.
+  size_t weight() const {
+    return in_weight_ + main_weight_;
+  }
+
+  /// @returns The number of elements in the cache.
+  size_t size() const {
+    return in_.size() + main_.size();
+  }
+
+  /// @returns `true` iff the cache holds no elements.
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /// @returns The hit, miss, and eviction counters.
+  const cache_statistics& statistics() const {
+    return statistics_;
+  }
+
+  // -- iteration -------------------------------------------------------------
+
+  /// Applies a function to all elements, first to those in A1in and then to
+  /// those in Am, without marking them as used.
+  /// @param f The function to invoke with each element.
+  template <class F>
+  void for_each(F f) const {
+    for (auto& x : in_)
+      f(x);
+    for (auto& x : main_)
+      f(x);
+  }
+
+  // -- lookup --------------------------------------------------------------
+
+  /// Looks up a value and marks it as used.
+  /// @param x The key to lookup.
+  /// @returns A pointer to the value for *x* or `nullptr` if *x* is not in
+  ///          the cache.
+  mapped_type* find(const key_type& x) {
+    auto i = tracker_.find(x);
+    if (i == tracker_.end()) {
+      ++statistics_.misses;
+      return nullptr;
+    }
+    ++statistics_.hits;
+    auto& loc = i->second;
+    // Entries in A1in stay in FIFO order, so that correlated references
+    // shortly after the insertion do not count as reuse.
+    if (loc.main)
+      main_.splice(main_.end(), main_, loc.position);
+    return &loc.position->second;
+  }
+
+  /// Checks whether a key is in the cache without updating any state.
+  /// @param x The key to check.
+  /// @returns `true` iff *x* is in the cache.
+  bool contains(const key_type& x) const {
+    return tracker_.count(x) > 0;
+  }
+
+  // -- modifiers -----------------------------------------------------------
+
+  /// Inserts or replaces an entry and evicts other entries until the cache
+  /// does not exceed its capacity. An entry that exceeds the capacity on its
+  /// own remains in the cache until the next insertion.
+  /// @param key The key mapping to *value*.
+  /// @param value The value for *key*.
+  /// @returns A pointer to the value in the cache.
+  mapped_type* emplace(key_type key, mapped_type value) {
+    auto w = weigher_(value);
+    if (auto i = tracker_.find(key); i != tracker_.end()) {
+      auto& loc = i->second;
+      (loc.main ? main_weight_ : in_weight_) += w - loc.weight;
+      loc.weight = w;
+      loc.position->second = std::move(value);
+      shrink(&*loc.position);
+      return &loc.position->second;
+    }
+    location loc;
+    loc.weight = w;
+    if (auto i = ghosts_.find(key); i != ghosts_.end()) {
+      // The entry has been requested again after leaving A1in.
+      out_weight_ -= i->second->second;
+      out_.erase(i->second);
+      ghosts_.erase(i);
+      loc.main = true;
+      loc.position = main_.emplace(main_.end(), std::move(key),
+                                   std::move(value));
+      main_weight_ += w;
+    } else {
+      loc.main = false;
+      loc.position = in_.emplace(in_.end(), std::move(key), std::move(value));
+      in_weight_ += w;
+    }
+    auto result = loc.position;
+    tracker_.emplace(result->first, loc);
+    shrink(&*result);
+    return &result->second;
+  }
+
+  /// Removes an entry for a given key.
+  /// @param x The key to remove.
+  /// @returns The number of entries removed.
+  size_t erase(const key_type& x) {
+    auto i = tracker_.find(x);
+    if (i == tracker_.end())
+      return 0;
+    auto& loc = i->second;
+    if (loc.main) {
+      main_weight_ -= loc.weight;
+      main_.erase(loc.position);
+    } else {
+      in_weight_ -= loc.weight;
+      in_.erase(loc.position);
+    }
+    tracker_.erase(i);
+    return 1;
+  }
+
+  /// Removes all elements from the cache.
+  void clear() {
+    in_.clear();
+    main_.clear();
+    out_.clear();
+    tracker_.clear();
+    ghosts_.clear();
+    in_weight_ = 0;
+    main_weight_ = 0;
+    out_weight_ = 0;
+  }
+
+private:
+  using iterator = typename std::list<value_type>::iterator;
+  using ghost_iterator = typename std::list<std::pair<Key, size_t>>::iterator;
+
+  struct location {
+    bool main;
+    iterator position;
+    size_t weight;
+  };
+
+  // Evicts entries other than *keep* until the cache fits its capacity.
+  void shrink(const value_type* keep) {
+    while (weight() > capacity_) {
+      auto can_evict_in = !in_.empty() && &in_.front() != keep;
+      auto can_evict_main = !main_.empty() && &main_.front() != keep;
+      // Prefer evicting from A1in while it exceeds its share of the capacity.
+      if (can_evict_in && (in_weight_ > capacity_ / 4 || !can_evict_main))
+        evict_in();
+      else if (can_evict_main)
+        evict_main();
+      else
+        break;
+    }
+  }
+
+  void evict_in() {
+    auto& victim = in_.front();
+    auto i = tracker_.find(victim.first);
+    VAST_ASSERT(i != tracker_.end());
+    auto w = i->second.weight;
+    in_weight_ -= w;
+    tracker_.erase(i);
+    // Remember the key, so that a repeated request promotes it into Am.
+    auto g = out_.emplace(out_.end(), victim.first, w);
+    ghosts_.emplace(g->first, g);
+    out_weight_ += w;
+    in_.pop_front();
+    ++statistics_.evictions;
+    while (out_weight_ > capacity_ / 2 && out_.size() > 1) {
+      out_weight_ -= out_.front().second;
+      ghosts_.erase(out_.front().first);
+      out_.pop_front();
+    }
+  }
+
+  void evict_main() {
+    auto& victim = main_.front();
+    auto i = tracker_.find(victim.first);
+    VAST_ASSERT(i != tracker_.end());
+    main_weight_ -= i->second.weight;
+    tracker_.erase(i);
+    main_.pop_front();
+    ++statistics_.evictions;
+  }
+
+  std::list<value_type> in_;
+  std::list<value_type> main_;
+  std::list<std::pair<Key, size_t>> out_;
+  std::unordered_map<key_type, location> tracker_;
+  std::unordered_map<key_type, ghost_iterator> ghosts_;
+  size_t in_weight_ = 0;
+  size_t main_weight_ = 0;
+  size_t out_weight_ = 0;
+  size_t capacity_;
+  weigher weigher_;
+  cache_statistics statistics_;
+};
+
 } // namespace vast::detail
 
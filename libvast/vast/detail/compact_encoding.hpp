@@ -0,0 +1,62 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <caf/error.hpp>
+
+#include "vast/fwd.hpp"
+#include "vast/span.hpp"
+
+/// A compact encoding for the cells of a table slice, which relies on the
+/// layout to determine the type of each column. The encoding consists of one
+/// block per column, each of which has the following format:
+///
+///     +-------------------------------+
+///     |  flags (1 byte)               |
+///     +-------------------------------+
+///     |  validity bitmap (optional)   |
+///     +-------------------------------+
+///     |  values of non-nil cells      |
+///     +-------------------------------+
+///
+/// The validity bitmap has one bit per row and exists only if the column has
+/// nil cells. Values carry no type tags. Booleans are packed into bits,
+/// integers and durations are zig-zag and variable-byte encoded, counts
+/// are variable-byte encoded, and timestamps are encoded as zig-zag deltas
+/// to their predecessor in the column. A string column stores the lengths of
+/// all strings first, followed by the concatenated characters. Columns of any
+/// other type, or whose cells do not match the layout, fall back to the
+/// generic CAF encoding of each cell with a length prefix.
+namespace vast::detail {
+
+/// Appends the cells of a table slice to a buffer in the compact encoding.
+/// @param buf The buffer to append to.
+/// @param xs The table slice to encode.
+void compact_encode(std::vector<char>& buf, const table_slice& xs);
+
+/// Decodes the cells of a table slice from the compact encoding.
+/// @param bytes The encoded cells.
+/// @param layout The layout of the table slice.
+/// @param rows The number of rows of the table slice.
+/// @param cell Returns the storage for the cell at a given row and column.
+/// @returns An error if *bytes* do not hold a valid encoding.
+caf::error compact_decode(span<const char> bytes, const record_type& layout,
+                          size_t rows,
+                          const std::function<data&(size_t, size_t)>& cell);
+
+} // namespace vast::detail
@@ -0,0 +1,79 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <caf/intrusive_ptr.hpp>
+#include <caf/ref_counted.hpp>
+
+namespace vast::detail {
+
+/// A thread-safe pool of objects that own reusable storage, such as the
+/// buffers of a table slice. Producers acquire objects from the pool and
+/// consumers, possibly on other threads, release them when done.
+template <class T>
+class object_pool : public caf::ref_counted {
+public:
+  /// Constructs an empty pool.
+  /// @param capacity The maximum number of objects that the pool keeps.
+  explicit object_pool(size_t capacity) : capacity_{capacity} {
+    xs_.reserve(capacity);
+  }
+
+  /// Takes an object out of the pool.
+  /// @returns a released object or a default-constructed object if the pool
+  ///          is empty.
+  T acquire() {
+    std::lock_guard<std::mutex> guard{mtx_};
+    if (xs_.empty())
+      return T{};
+    auto result = std::move(xs_.back());
+    xs_.pop_back();
+    return result;
+  }
+
+  /// Puts an object into the pool, or destroys it if the pool is full.
+  /// @param x The object to recycle.
+  void release(T&& x) {
+    std::unique_lock<std::mutex> guard{mtx_};
+    if (xs_.size() < capacity_) {
+      xs_.push_back(std::move(x));
+      return;
+    }
+    // Destroy the object outside of the critical section.
+    guard.unlock();
+    auto discarded = std::move(x);
+  }
+
+  /// @returns the number of objects in the pool.
+  size_t size() const {
+    std::lock_guard<std::mutex> guard{mtx_};
+    return xs_.size();
+  }
+
+private:
+  mutable std::mutex mtx_;
+  std::vector<T> xs_;
+  size_t capacity_;
+};
+
+/// @relates object_pool
+template <class T>
+using object_pool_ptr = caf::intrusive_ptr<object_pool<T>>;
+
+} // namespace vast::detail
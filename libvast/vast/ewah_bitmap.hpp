@@ -17,6 +17,7 @@
 #include "vast/bitvector.hpp"
 #include "vast/word.hpp"
 
+#include "vast/detail/block_kernels.hpp"
 #include "vast/detail/operators.hpp"
 
 namespace vast {
@@ -112,6 +113,10 @@ public:
 
   void append_block(block_type bits, size_type n = word_type::width);
 
+  /// Appends a sequence of complete blocks. Equivalent to calling
+  /// `append_block(x)` for every block *x* in `[first, last)`.
+  void append_blocks(const block_type* first, const block_type* last);
+
   void flip();
 
   // -- concepts -------------------------------------------------------------
@@ -160,6 +165,37 @@ private:
 
 ewah_bitmap_range bit_range(const ewah_bitmap& bm);
 
+// -- bitwise operations -------------------------------------------------------
+
+/// Applies a bitwise operation to two EWAH bitmaps. In contrast to the generic
+/// ::binary_eval, the algorithm operates directly on the compressed blocks: it
+/// consumes clean runs of both sides at once, skips the dirty blocks facing a
+/// run that determines the result, and combines stretches of dirty blocks on
+/// both sides with a vectorized kernel. The shorter bitmap counts as if padded
+/// with zeros, which yields the same result as the generic algorithm.
+/// @param lhs The left-hand side.
+/// @param rhs The right-hand side.
+/// @param op The operation.
+/// @param kernels The kernels that combine stretches of dirty blocks.
+/// @returns the result of *op* on *lhs* and *rhs*.
+/// @relates ewah_bitmap
+ewah_bitmap binary_eval(const ewah_bitmap& lhs, const ewah_bitmap& rhs,
+                        detail::block_operation op,
+                        const detail::block_kernels& kernels
+                        = detail::simd_block_kernels());
+
+/// @relates ewah_bitmap
+ewah_bitmap binary_and(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+/// @relates ewah_bitmap
+ewah_bitmap binary_or(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+/// @relates ewah_bitmap
+ewah_bitmap binary_xor(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+/// @relates ewah_bitmap
+ewah_bitmap binary_nand(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
 } // namespace vast
 
 
@@ -18,11 +18,13 @@
 #include <memory>
 #include <new>
 #include <type_traits>
+#include <vector>
 
 #include <caf/deserializer.hpp>
 #include <caf/serializer.hpp>
 
 #include "vast/data.hpp"
+#include "vast/detail/compact_encoding.hpp"
 #include "vast/detail/range.hpp"
 #include "vast/policy/column_major.hpp"
 #include "vast/policy/row_major.hpp"
@@ -89,17 +91,19 @@ public:
   }
 
   caf::error serialize(caf::serializer& sink) const override {
-    for (auto i = begin(); i != end(); ++i)
-      if (auto err = sink(*i))
-        return err;
-    return caf::none;
+    std::vector<char> buf;
+    detail::compact_encode(buf, *this);
+    return sink(buf);
   }
 
   caf::error deserialize(caf::deserializer& source) override {
-    for (auto i = begin(); i != end(); ++i)
-      if (auto err = source(*i))
-        return err;
-    return caf::none;
+    std::vector<char> buf;
+    if (auto err = source(buf))
+      return err;
+    auto cell = [&](size_type row, size_type col) -> data& {
+      return storage()[LayoutPolicy::index_of(rows(), columns(), row, col)];
+    };
+    return detail::compact_decode(buf, layout(), rows(), cell);
   }
 
   void append_column_to_index(size_type col, value_index& idx) const override {
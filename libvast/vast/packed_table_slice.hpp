@@ -0,0 +1,141 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <caf/atom.hpp>
+
+#include "vast/chunk.hpp"
+#include "vast/fwd.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/view.hpp"
+
+namespace vast {
+
+/// A table slice that keeps its cells in a single contiguous chunk of bytes
+/// and answers accesses with views into that chunk. When loaded from a
+/// memory-mapped segment, the slice does not copy or allocate any cell data.
+///
+/// The chunk has the following format, where all integers are 32-bit values
+/// and offsets are relative to the beginning of the chunk or to the cell data
+/// of the column, respectively:
+///
+///     +-------------------------------+
+///     |  column offsets [columns]     |
+///     +-------------------------------+ <- column offset
+///     |  cell offsets [rows + 1]      |
+///     +-------------------------------+
+///     |  cell data                    |
+///     +-------------------------------+
+///     |  dictionary (optional)        |
+///     +-------------------------------+
+///     .  further columns              .
+///
+/// Each cell consists of a one-byte type tag followed by the value in its
+/// native representation. Containers hold their element count, followed by
+/// element offsets and the recursively encoded elements.
+///
+/// String columns with few distinct values may store each distinct string
+/// once in a dictionary after the cell data. Cells then hold a 16-bit code
+/// that indexes into the dictionary, which has the same format as a vector
+/// of raw strings. A column has a dictionary if and only if its bytes extend
+/// beyond the end of the cell data.
+class packed_table_slice final : public table_slice {
+public:
+  // -- constants --------------------------------------------------------------
+
+  static constexpr caf::atom_value class_id = caf::atom("packed");
+
+  // -- static factory functions -----------------------------------------------
+
+  static table_slice_ptr make(table_slice_header header);
+
+  /// Appends the encoding of a single cell to a buffer.
+  /// @param buf The buffer to append to.
+  /// @param x The value to encode.
+  static void encode(std::vector<char>& buf, data_view x);
+
+  /// Decodes a single cell.
+  /// @param ptr The beginning of the encoded cell.
+  /// @param size The size of the encoded cell.
+  /// @returns A view that points into the encoded bytes.
+  /// @pre The cell is not a dictionary code.
+  static data_view decode(const char* ptr, size_t size);
+
+  /// Appends a cell that refers to an entry in the column dictionary.
+  /// @param buf The buffer to append to.
+  /// @param code The index of the dictionary entry.
+  static void encode_code(std::vector<char>& buf, uint16_t code);
+
+  /// Appends a column dictionary.
+  /// @param buf The buffer to append to.
+  /// @param entries The distinct strings, indexed by their code.
+  static void encode_dictionary(std::vector<char>& buf,
+                                const std::vector<std::string_view>& entries);
+
+  // -- factory functions ------------------------------------------------------
+
+  packed_table_slice* copy() const final;
+
+  // -- persistence ------------------------------------------------------------
+
+  caf::error serialize(caf::serializer& sink) const final;
+
+  caf::error deserialize(caf::deserializer& source) final;
+
+  /// Points the slice directly into *chunk* without copying any data.
+  caf::error load(chunk_ptr chunk) final;
+
+  // -- properties -------------------------------------------------------------
+
+  data_view at(size_type row, size_type col) const final;
+
+  caf::atom_value implementation_id() const noexcept final;
+
+  // -- projection -------------------------------------------------------------
+
+  /// Copies the encoded bytes of the selected columns into a new chunk. Since
+  /// every column occupies a contiguous range of the chunk, the projection
+  /// does not touch the bytes of other columns.
+  table_slice_ptr project(const std::vector<size_type>& columns) const final;
+
+  /// @returns the chunk holding the encoded cells.
+  const chunk_ptr& chunk() const noexcept {
+    return chunk_;
+  }
+
+private:
+  // -- friends ----------------------------------------------------------------
+
+  friend class packed_table_slice_builder;
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  explicit packed_table_slice(table_slice_header header);
+
+  // -- utility functions ------------------------------------------------------
+
+  /// Checks whether the chunk can hold the column and cell offsets.
+  caf::error validate() const;
+
+  // -- member variables -------------------------------------------------------
+
+  chunk_ptr chunk_;
+};
+
+} // namespace vast
@@ -0,0 +1,112 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "vast/packed_table_slice.hpp"
+#include "vast/table_slice_builder.hpp"
+
+namespace vast {
+
+/// Builds a @ref packed_table_slice by encoding each cell directly into a
+/// per-column byte buffer. With dictionary encoding enabled, the builder
+/// additionally encodes string columns as codes into a per-column dictionary
+/// and keeps that encoding for every column where it is smaller.
+class packed_table_slice_builder final : public table_slice_builder {
+public:
+  // -- member types -----------------------------------------------------------
+
+  using super = table_slice_builder;
+
+  // -- class properties -------------------------------------------------------
+
+  static caf::atom_value get_implementation_id() noexcept;
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  /// @param layout The layout of the slices to build.
+  /// @param dictionary_encoding Whether to consider dictionary encoding for
+  ///        string columns.
+  explicit packed_table_slice_builder(record_type layout,
+                                      bool dictionary_encoding = false);
+
+  ~packed_table_slice_builder() override;
+
+  // -- factory functions ------------------------------------------------------
+
+  /// @returns a table slice builder instance.
+  static table_slice_builder_ptr make(record_type layout);
+
+  // -- properties -------------------------------------------------------------
+
+  bool add(data_view x) override;
+
+  table_slice_ptr finish() override;
+
+  size_t rows() const noexcept override;
+
+  void reserve(size_t num_rows) override;
+
+  caf::atom_value implementation_id() const noexcept override;
+
+private:
+  // -- member types -----------------------------------------------------------
+
+  /// The encoded cells of a single column.
+  struct column_buffer {
+    std::vector<uint32_t> offsets;
+    std::vector<char> cells;
+    /// Whether the column tracks a dictionary encoding.
+    bool dictionary = false;
+    /// The cells with strings replaced by dictionary codes.
+    std::vector<uint32_t> coded_offsets;
+    std::vector<char> coded_cells;
+    /// The distinct strings. A deque keeps their addresses stable.
+    std::deque<std::string> strings;
+    /// Maps distinct strings to their codes.
+    std::unordered_map<std::string_view, uint16_t> codes;
+    /// The distinct strings, indexed by code.
+    std::vector<std::string_view> entries;
+  };
+
+  // -- utility functions ------------------------------------------------------
+
+  /// Appends the dictionary encoding of a cell to a column.
+  void add_code(column_buffer& column, data_view x);
+
+  /// Resets the state of all columns for the next slice.
+  void reset_columns();
+
+  // -- member variables -------------------------------------------------------
+
+  /// Whether to consider dictionary encoding for string columns.
+  bool dictionary_encoding_;
+
+  /// Current column index.
+  size_t col_;
+
+  /// Number of complete rows.
+  size_t rows_;
+
+  /// Encoded cells by column.
+  std::vector<column_buffer> columns_;
+};
+
+} // namespace vast
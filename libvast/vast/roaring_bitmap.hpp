@@ -0,0 +1,280 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <caf/variant.hpp>
+
+#include "vast/bitmap_base.hpp"
+#include "vast/detail/block_kernels.hpp"
+#include "vast/detail/operators.hpp"
+
+namespace vast {
+
+class roaring_bitmap_range;
+
+/// A bitmap in the spirit of *Roaring*. The bitmap partitions its positions
+/// into chunks of 2^16 bits, keyed by the remaining high bits of a position,
+/// and only stores the chunks that contain a 1-bit. Depending on its contents,
+/// a chunk holds one of three containers: a sorted array of positions for
+/// sparse chunks, an uncompressed bitset for dense chunks, or a list of runs
+/// for clustered chunks. Since empty chunks take no space, the representation
+/// suits sparse and scattered ID sets over a large ID space, e.g., the hits of
+/// a query. Consecutive chunks with all bits set share a single entry as
+/// well, so that the complement of a sparse bitmap stays small.
+///
+/// The implementation maintains the following invariants: every stored
+/// container has at least one 1-bit, no container has a 1-bit at or beyond
+/// `size()`, and no two adjacent chunks both have all bits set.
+class roaring_bitmap : public bitmap_base<roaring_bitmap>,
+                       detail::equality_comparable<roaring_bitmap> {
+  friend roaring_bitmap_range;
+
+public:
+  /// The number of bits per chunk.
+  static constexpr size_type chunk_size = size_type{1} << 16;
+
+  /// The number of blocks per chunk in a bitset container.
+  static constexpr size_t chunk_blocks = chunk_size / word_type::width;
+
+  /// The maximum number of positions in an array container.
+  static constexpr size_t max_array_size = 4096;
+
+  /// The maximum number of runs in a run container.
+  static constexpr size_t max_runs = 2048;
+
+  /// A sorted list of the chunk-relative positions of all 1-bits.
+  struct array_container {
+    std::vector<uint16_t> values;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, array_container& x) {
+      return f(x.values);
+    }
+  };
+
+  /// An uncompressed sequence of `chunk_blocks` blocks.
+  struct bitset_container {
+    std::vector<block_type> blocks;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, bitset_container& x) {
+      return f(x.blocks);
+    }
+  };
+
+  /// A closed interval of chunk-relative positions of 1-bits.
+  struct run {
+    uint16_t first;
+    uint16_t last;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, run& x) {
+      return f(x.first, x.last);
+    }
+  };
+
+  /// A sorted list of non-overlapping runs.
+  struct run_container {
+    std::vector<run> runs;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, run_container& x) {
+      return f(x.runs);
+    }
+  };
+
+  /// Sets all bits of at least two consecutive chunks.
+  struct full_container {
+    /// The number of chunks.
+    size_type chunks;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, full_container& x) {
+      return f(x.chunks);
+    }
+  };
+
+  using container = caf::variant<
+    array_container,
+    bitset_container,
+    run_container,
+    full_container
+  >;
+
+  /// A container together with the high bits of its positions. A full
+  /// container spans the keys *[key, key + chunks)*.
+  struct chunk {
+    size_type key;
+    container data;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, chunk& x) {
+      return f(x.key, x.data);
+    }
+  };
+
+  roaring_bitmap() = default;
+
+  explicit roaring_bitmap(size_type n, bool bit = false);
+
+  // -- inspectors -----------------------------------------------------------
+
+  bool empty() const;
+
+  size_type size() const;
+
+  const std::vector<chunk>& chunks() const;
+
+  /// @returns The number of 1-bits.
+  size_type count() const;
+
+  /// @returns The number of 1-bits in *[0, i]*.
+  /// @pre `i < size()`
+  size_type count(size_type i) const;
+
+  /// @returns The position of the *i*-th 1-bit or `word_type::npos` if the
+  ///          bitmap has less than *i* 1-bits.
+  /// @pre `i > 0`
+  size_type find(size_type i) const;
+
+  /// @returns The position of the last 1-bit or `word_type::npos` if the
+  ///          bitmap has no 1-bits.
+  size_type find_last() const;
+
+  // -- modifiers ------------------------------------------------------------
+
+  void append_bit(bool bit);
+
+  void append_bits(bool bit, size_type n);
+
+  void append_block(block_type bits, size_type n = word_type::width);
+
+  void flip();
+
+  // -- concepts -------------------------------------------------------------
+
+  friend bool operator==(const roaring_bitmap& x, const roaring_bitmap& y);
+
+  template <class Inspector>
+  friend auto inspect(Inspector&f, roaring_bitmap& bm) {
+    return f(bm.chunks_, bm.size_);
+  }
+
+  friend roaring_bitmap binary_eval(const roaring_bitmap& lhs,
+                                    const roaring_bitmap& rhs,
+                                    detail::block_operation op);
+
+private:
+  /// Sets a single bit at a position after all 1-bits.
+  void add(size_type i);
+
+  /// Sets the bits in *[first, first + n)*, which lie after all 1-bits.
+  void add(size_type first, size_type n);
+
+  /// Merges the last chunk into its predecessor if both have all bits set.
+  void merge_back();
+
+  std::vector<chunk> chunks_;
+  size_type size_ = 0;
+};
+
+class roaring_bitmap_range
+  : public bit_range_base<roaring_bitmap_range, roaring_bitmap::block_type> {
+public:
+  using word_type = roaring_bitmap::word_type;
+
+  roaring_bitmap_range() = default;
+
+  explicit roaring_bitmap_range(const roaring_bitmap& bm);
+
+  void next();
+  bool done() const;
+
+private:
+  void scan();
+
+  const roaring_bitmap* bm_ = nullptr;
+  size_t chunk_ = 0;
+  size_t cursor_ = 0;
+  roaring_bitmap::size_type position_ = 0;
+};
+
+roaring_bitmap_range bit_range(const roaring_bitmap& bm);
+
+// -- bitwise operations -------------------------------------------------------
+
+/// Applies a bitwise operation to two Roaring bitmaps chunk by chunk. Chunks
+/// that exist on one side only get copied or dropped as a whole, two arrays
+/// get merged, and all other pairs of containers get combined block-wise. The
+/// shorter bitmap counts as if padded with zeros, which yields the same result
+/// as the generic ::binary_eval.
+/// @param lhs The left-hand side.
+/// @param rhs The right-hand side.
+/// @param op The operation.
+/// @returns the result of *op* on *lhs* and *rhs*.
+/// @relates roaring_bitmap
+roaring_bitmap binary_eval(const roaring_bitmap& lhs,
+                           const roaring_bitmap& rhs,
+                           detail::block_operation op);
+
+/// @relates roaring_bitmap
+roaring_bitmap binary_and(const roaring_bitmap& lhs, const roaring_bitmap& rhs);
+
+/// @relates roaring_bitmap
+roaring_bitmap binary_or(const roaring_bitmap& lhs, const roaring_bitmap& rhs);
+
+/// @relates roaring_bitmap
+roaring_bitmap binary_xor(const roaring_bitmap& lhs, const roaring_bitmap& rhs);
+
+/// @relates roaring_bitmap
+roaring_bitmap binary_nand(const roaring_bitmap& lhs,
+                           const roaring_bitmap& rhs);
+
+// -- algorithms ---------------------------------------------------------------
+
+// The following overloads take precedence over the generic algorithms and
+// compute their results from the container cardinalities instead of walking
+// the bit range.
+
+/// @relates roaring_bitmap
+template <bool Bit = true>
+roaring_bitmap::size_type rank(const roaring_bitmap& bm,
+                               roaring_bitmap::size_type i) {
+  VAST_ASSERT(i < bm.size());
+  auto ones = bm.count(i);
+  return Bit ? ones : i + 1 - ones;
+}
+
+/// @relates roaring_bitmap
+template <bool Bit = true>
+roaring_bitmap::size_type rank(const roaring_bitmap& bm) {
+  auto ones = bm.count();
+  return Bit ? ones : bm.size() - ones;
+}
+
+/// @relates roaring_bitmap
+/// @note Selecting 0-bits uses the generic algorithm.
+template <bool Bit = true>
+std::enable_if_t<Bit, roaring_bitmap::size_type>
+select(const roaring_bitmap& bm, roaring_bitmap::size_type i) {
+  VAST_ASSERT(i > 0);
+  return i == roaring_bitmap::word_type::npos ? bm.find_last() : bm.find(i);
+}
+
+} // namespace vast
@@ -26,16 +26,14 @@
 
 #include "vast/aliases.hpp"
 #include "vast/chunk.hpp"
+#include "vast/compression.hpp"
 #include "vast/fwd.hpp"
 #include "vast/segment_header.hpp"
+#include "vast/span.hpp"
 #include "vast/uuid.hpp"
 
 namespace vast {
 
-// TODO: use a format that's more conducive to mmap'ing, e.g., flatbuffers.
-// Right now we use a packed struct for the header as a poor-man's abstraction
-// for this, but it's inconvenient.
-
 /// @relates segment
 using segment_ptr = caf::intrusive_ptr<segment>;
 
@@ -46,19 +44,34 @@ using segment_ptr = caf::intrusive_ptr<segment>;
 ///               |       magic        |      version       | ^
 ///               +--------------------+--------------------+ |
 ///               |                 segment                 | | segment header
-///               |                  UUID                   | v
+///               |                  UUID                   | |
+///               +-----------------------------------------+ |
+///               |             payload offset              | v
 ///               +-----------------------------------------+
+///               |              footer offset              | ^
+///               +-----------------------------------------+ | index
+///               |             number of slices            | | descriptor
+///               +-----------------------------------------+ |
+///               |  compression   |        reserved        | v
+///               +-----------------------------------------+ <- payload offset
 ///               .                                         . ^
-///               .                meta data                . | variable size
-///               .                                         . v
-///               +-----------------------------------------+
-///               .                                         . ^
-///               .                                         . |
 ///               .               table slices              . | variable size
-///               .                                         . |
 ///               .                                         . v
+///               +-----------------------------------------+ <- footer offset
+///               .                                         . ^
+///               .              footer index               . | 48 bytes per
+///               .                                         . v slice
 ///               +-----------------------------------------+
 ///
+/// All fields have a fixed size and native byte order, and the footer index
+/// is 8-byte aligned. Opening a segment therefore only validates the header
+/// and the footer entries and points into the chunk, and lookups perform a
+/// binary search over the footer index. Segments of version 1 and 2 stored
+/// the meta data as a variable-size, CAF-serialized structure after the
+/// header. The segment converts them into the current format when loading
+/// them. In segments up to version 3, default and matrix table slices encode
+/// each cell generically rather than in the compact encoding. The segment
+/// rebuilds such slices when accessing them.
 class segment : public caf::ref_counted {
   friend segment_builder;
 
@@ -69,24 +82,15 @@ public:
   static inline constexpr segment_magic_type magic = 0x2a547ea8;
 
   /// The current version of the segment format.
-  static inline constexpr segment_version_type version = 1;
+  static inline constexpr segment_version_type version = 4;
 
-  /// Per-slice meta data.
-  struct table_slice_synopsis {
-    int64_t start;    ///< The byte offset from the beginning of the payload.
-    int64_t end;      ///< The byte offset to one past the end of the slice.
-    id offset;        ///< The offset in the ID space where the slice starts.
-    uint64_t size;    ///< The number of rows in the slice.
-  };
-
-  /// Meta data for a segment.
-  struct meta_data {
-    std::vector<table_slice_synopsis> slices;
-  };
+  /// The number of bytes before the payload.
+  static inline constexpr size_t payload_offset
+    = sizeof(segment_header) + sizeof(segment_index_descriptor);
 
   /// Constructs a segment.
-  /// @param header The header of the segment.
   /// @param chunk The chunk holding the segment data.
+  /// @returns The segment or `nullptr` if *chunk* contains no valid segment.
   static segment_ptr make(chunk_ptr chunk);
 
   /// @returns The unique ID of this segment.
@@ -98,6 +102,12 @@ public:
   /// @returns the number of tables slices in the segment.
   size_t num_slices() const;
 
+  /// @returns the compression method of the table slices.
+  compression compression_method() const;
+
+  /// @returns the footer index with one entry per table slice.
+  span<const segment_slice_entry> slices() const;
+
   /// Locates the table slices for a given set of IDs.
   /// @param xs The IDs to lookup.
   /// @returns The table slices according to *xs*.
@@ -115,23 +125,13 @@ private:
   segment() = default;
 
   caf::expected<table_slice_ptr>
-  make_slice(const table_slice_synopsis& slice) const;
+  make_slice(const segment_slice_entry& slice) const;
 
-  meta_data meta_;
   chunk_ptr chunk_;
   segment_header header_;
+  compression method_;
+  const segment_slice_entry* slices_;
+  size_t num_slices_;
 };
 
-/// @relates segment::table_slice_synopsis
-template <class Inspector>
-auto inspect(Inspector& f, segment::table_slice_synopsis& x) {
-  return f(x.start, x.end, x.offset, x.size);
-}
-
-/// @relates segment::meta_data
-template <class Inspector>
-auto inspect(Inspector& f, segment::meta_data& x) {
-  return f(x.slices);
-}
-
 } // namespace vast
@@ -22,6 +22,7 @@
 #include <caf/streambuf.hpp>
 
 #include "vast/aliases.hpp"
+#include "vast/compression.hpp"
 #include "vast/segment.hpp"
 #include "vast/uuid.hpp"
 
@@ -32,7 +33,14 @@ namespace vast {
 class segment_builder {
 public:
   /// Constructs a segment builder.
-  segment_builder();
+  /// @param method The method to compress each table slice with.
+  /// @param columnar Whether to store table slices column by column, which
+  ///        allows lookups to read only the projected columns.
+  /// @param dictionary_encoding Whether to store low-cardinality string
+  ///        columns as codes into a per-slice dictionary. Implies *columnar*.
+  explicit segment_builder(compression method = compression::null,
+                           bool columnar = false,
+                           bool dictionary_encoding = false);
 
   /// Adds a table slice to the segment.
   /// @returns An error if adding the table slice failed.
@@ -57,16 +65,29 @@ public:
   /// @returns The number of bytes of the current segment.
   size_t table_slice_bytes() const;
 
+  /// @returns The compression method for table slices.
+  compression compression_method() const;
+
+  /// @returns Whether the builder stores table slices column by column.
+  bool columnar() const;
+
+  /// @returns Whether the builder dictionary-encodes string columns.
+  bool dictionary_encoding() const;
+
 private:
   // Resets the builder state to start with a new segment.
   void reset();
 
   // Segment state
-  segment::meta_data meta_;
+  compression method_;
+  bool columnar_;
+  bool dictionary_encoding_;
+  std::vector<segment_slice_entry> slices_index_;
   uuid id_;
   // Table slice state
   vast::id min_table_slice_offset_;
   std::vector<char> table_slice_buffer_;
+  std::vector<char> uncompressed_buffer_;
   caf::vectorbuf table_slice_streambuf_;
   caf::stream_serializer<caf::vectorbuf&> table_slice_serializer_;
   // Lookup cache
@@ -15,6 +15,7 @@
 
 #include <cstdint>
 
+#include "vast/compression.hpp"
 #include "vast/uuid.hpp"
 
 namespace vast {
@@ -44,4 +45,29 @@ auto inspect(Inspector& f, segment_header& x) {
   return f(x.magic, x.version, x.id, x.payload_offset);
 }
 
+/// Locates the footer index of a segment. Follows the header directly.
+/// @relates segment
+struct segment_index_descriptor {
+  uint64_t footer_offset;         ///< The offset of the footer in the segment.
+  uint64_t num_slices;            ///< The number of entries in the footer.
+  compression method;             ///< The compression method of all slices.
+  uint8_t reserved[7];            ///< Padding for 8-byte alignment.
+};
+
+static_assert(sizeof(segment_index_descriptor) == 24);
+
+/// An entry in the footer index of a segment that describes one table slice.
+/// The footer holds one entry per table slice, sorted by ID offset.
+/// @relates segment
+struct segment_slice_entry {
+  uint64_t offset;                ///< The ID offset of the slice.
+  uint64_t rows;                  ///< The number of rows in the slice.
+  uint64_t start;                 ///< The byte offset relative to the payload.
+  uint64_t end;                   ///< One past the last byte of the slice.
+  uint64_t uncompressed_size;     ///< The size of the slice before compression.
+  uint64_t layout_digest;         ///< The xxhash64 digest of the slice layout.
+};
+
+static_assert(sizeof(segment_slice_entry) == 48);
+
 } // namespace vast
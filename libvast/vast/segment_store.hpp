@@ -13,8 +13,17 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <caf/error.hpp>
 #include <caf/fwd.hpp>
 
+#include "vast/compression.hpp"
+#include "vast/defaults.hpp"
 #include "vast/filesystem.hpp"
 #include "vast/fwd.hpp"
 #include "vast/segment.hpp"
@@ -30,22 +39,47 @@ namespace vast {
 /// @relates segment_store
 using segment_store_ptr = std::unique_ptr<segment_store>;
 
-/// A store that keeps its data in terms of segments.
+/// A store that keeps its data in terms of segments. Full segments get written
+/// to disk by a dedicated I/O thread, so that adding table slices does not
+/// block on the file system. Segments remain queryable while they wait for
+/// the I/O thread.
+///
+/// The store persists the mapping from IDs to segments as a checkpoint plus
+/// an append-only journal of the ID ranges of every new segment. Writing a
+/// segment only appends to the journal. Once the journal outgrows the
+/// checkpoint, the I/O thread compacts both into a new checkpoint.
+///
+/// When the I/O thread fails to write a segment, the next call to `put` or
+/// `flush` reports the error once. The IDs of that segment remain unavailable
+/// after a restart, but the store keeps writing subsequent segments.
 class segment_store : public store {
 public:
   /// Constructs a segment store.
   /// @param dir The directory where to store state.
   /// @param max_segment_size The maximum segment size in bytes.
-  /// @param in_memory_segments The number of semgents to cache in memory.
-  /// @pre `max_segment_size > 0`
-  static segment_store_ptr make(path dir, size_t max_segment_size,
-                                size_t in_memory_segments);
+  /// @param cache_capacity The maximum number of bytes of segments to cache
+  ///        in memory.
+  /// @param method The compression method for table slices in new segments.
+  /// @param max_pending_segments The number of full segments that may wait
+  ///        for the I/O thread before `put` blocks.
+  /// @param columnar Whether new segments store table slices column by
+  ///        column, so that extraction reads only the projected columns.
+  /// @param dictionary_encoding Whether new segments store low-cardinality
+  ///        string columns as codes into per-slice dictionaries.
+  /// @pre `max_segment_size > 0 && max_pending_segments > 0`
+  static segment_store_ptr
+  make(path dir, size_t max_segment_size, size_t cache_capacity,
+       compression method = compression::null,
+       size_t max_pending_segments = defaults::system::max_pending_segments,
+       bool columnar = false, bool dictionary_encoding = false);
 
   ~segment_store();
 
   error put(table_slice_ptr xs) override;
 
-  std::unique_ptr<store::lookup> extract(const ids& xs) const override;
+  std::unique_ptr<store::lookup>
+  extract(const ids& xs,
+          const std::vector<size_t>& columns = {}) const override;
 
   caf::expected<std::vector<table_slice_ptr>>
   get(const ids& xs) override;
@@ -54,9 +88,20 @@ public:
 
   void inspect_status(caf::settings& dict) override;
 
+  /// Configures how lookup sessions from `extract` load segments. A session
+  /// loads up to *workers* segments concurrently in the background, but only
+  /// as many as fit into *max_bytes_in_flight*, assuming each segment has the
+  /// maximum segment size. Sessions still produce table slices in ID order.
+  /// @param workers The maximum number of concurrent segment loads.
+  /// @param max_bytes_in_flight The memory budget for segments in flight.
+  /// @pre `workers > 0`
+  void parallel_extraction(size_t workers, size_t max_bytes_in_flight);
+
   /// @cond PRIVATE
 
-  segment_store(path dir, uint64_t max_segment_size, size_t in_memory_segments);
+  segment_store(path dir, uint64_t max_segment_size, size_t cache_capacity,
+                compression method, size_t max_pending_segments,
+                bool columnar, bool dictionary_encoding);
 
   /// @endcond
 
@@ -65,18 +110,95 @@ private:
     return dir_ / "meta";
   }
 
+  path journal_path() const {
+    return dir_ / "meta.journal";
+  }
+
   path segment_path() const {
     return dir_ / "segments";
   }
 
+  /// An entry in the journal that maps the ID range *[first, last)* to a
+  /// segment.
+  struct meta_record {
+    id first;
+    id last;
+    uuid segment;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, meta_record& x) {
+      return f(x.first, x.last, x.segment);
+    }
+  };
+
+  /// A finished segment that waits for the I/O thread.
+  struct pending_segment {
+    segment_ptr segment;
+    std::vector<meta_record> records;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+
+  /// Weighs cached segments by their size in bytes.
+  struct segment_weigher {
+    size_t operator()(const segment_ptr& x) const;
+  };
+
   caf::expected<segment_ptr> load_segment(uuid id) const;
 
+  /// Retrieves a finished segment from the cache or the queue of pending
+  /// segments.
+  /// @returns The segment or `nullptr` if it is only available on disk.
+  segment_ptr resident_segment(const uuid& id) const;
+
+  /// Retrieves a finished segment from the cache, the queue of pending
+  /// segments, or the file system.
+  caf::expected<segment_ptr> get_segment(const uuid& id) const;
+
+  /// Finishes the active segment and hands it to the I/O thread.
+  /// @returns The error of a failed write since the last report, if any.
+  caf::error finish_segment();
+
+  /// Blocks until the I/O thread has written all pending segments.
+  /// @returns The error of a failed write since the last report, if any.
+  caf::error await_pending();
+
+  /// Applies the journal on top of the checkpointed meta data.
+  caf::error replay_journal();
+
+  /// Appends the records of a written segment to the journal and compacts the
+  /// journal into a new checkpoint when it grows too large. Runs on the I/O
+  /// thread.
+  caf::error write_journal(const std::vector<meta_record>& records);
+
+  /// The main loop of the I/O thread.
+  void run_writer();
+
   path dir_;
   uint64_t max_segment_size_;
   detail::range_map<id, uuid> segments_;
-  mutable detail::cache<uuid, segment_ptr> cache_;
+  std::vector<meta_record> unjournaled_;
+  mutable detail::two_queue_cache<uuid, segment_ptr, segment_weigher> cache_;
   segment_builder builder_;
-  std::vector<segment_ptr> builder_slices_;
+  size_t extract_workers_;
+  size_t max_extract_bytes_;
+
+  // -- I/O thread state, guarded by `pending_mutex_` --------------------------
+
+  size_t max_pending_segments_;
+  mutable std::mutex pending_mutex_;
+  std::condition_variable pending_cv_;
+  std::deque<pending_segment> pending_;
+  bool shutdown_ = false;
+  caf::error write_error_; // The first unreported write error.
+  uint64_t written_segments_ = 0;
+  std::chrono::microseconds last_flush_latency_{0};
+  std::chrono::microseconds max_flush_latency_{0};
+
+  // -- I/O thread state, initialized before the first pending segment --------
+
+  detail::range_map<id, uuid> persisted_;
+  size_t journal_records_ = 0;
+  std::thread writer_;
 };
 
 } // namespace vast
@@ -13,6 +13,9 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include <caf/fwd.hpp>
 
 #include <caf/expected.hpp>
@@ -44,9 +47,13 @@ public:
 
   /// Starts an iterative extraction session.
   /// @param xs The IDs for the events to retrieve.
+  /// @param columns The offsets of the columns to retrieve in increasing
+  ///        order. Offsets beyond the width of a table slice are ignored. An
+  ///        empty list retrieves all columns.
   /// @returns A pointer to lookup session.
   /// @relates lookup
-  virtual std::unique_ptr<lookup> extract(const ids& xs) const = 0;
+  virtual std::unique_ptr<lookup>
+  extract(const ids& xs, const std::vector<size_t>& columns = {}) const = 0;
 
   /// Retrieves a set of events.
   /// @param xs The IDs for the events to retrieve.
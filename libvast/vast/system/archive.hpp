@@ -25,6 +25,7 @@
 #include <caf/typed_actor.hpp>
 #include <caf/typed_event_based_actor.hpp>
 
+#include "vast/compression.hpp"
 #include "vast/fwd.hpp"
 #include "vast/ids.hpp"
 #include "vast/store.hpp"
@@ -57,11 +58,17 @@ struct archive_state {
 /// Stores event batches and answers queries for ID sets.
 /// @param self The actor handle.
 /// @param dir The root directory of the archive.
-/// @param capacity The number of segments to cache in memory.
+/// @param capacity The number of maximum-sized segments to cache in memory.
+///        The cache holds `capacity * max_segment_size` bytes of segments.
 /// @param max_segment_size The maximum segment size in bytes.
+/// @param method The compression method for table slices in segments.
+/// @param columnar Whether segments store table slices column by column.
+/// @param dictionary_encoding Whether segments store low-cardinality string
+///        columns as codes into per-slice dictionaries.
 /// @pre `max_segment_size > 0`
 archive_type::behavior_type
 archive(archive_type::stateful_pointer<archive_state> self, path dir,
-        size_t capacity, size_t max_segment_size);
+        size_t capacity, size_t max_segment_size, compression method,
+        bool columnar, bool dictionary_encoding);
 
 } // namespace vast::system
@@ -63,6 +63,9 @@ struct datagram_source_state : source_state<Reader, caf::io::broker> {
 
   /// Shuts down the stream manager when `true`.
   bool done = false;
+
+  /// The arrival time of the previous datagram.
+  stopwatch::time_point last_datagram = stopwatch::time_point::min();
 };
 
 template <class Reader>
@@ -90,7 +93,7 @@ caf::behavior datagram_source(datagram_source_actor<Reader>* self,
   }
   VAST_DEBUG(self, "starts listening at port", udp_res->second);
   // Initialize state.
-  self->state.init(std::move(reader), factory);
+  self->state.init(std::move(reader), factory, table_slice_size);
   // Spin up the stream manager for the source.
   self->state.mgr = self->make_continuous_source(
     // init
@@ -115,6 +118,7 @@ caf::behavior datagram_source(datagram_source_actor<Reader>* self,
       // Check whether we can buffer more slices in the stream.
       VAST_DEBUG(self, "got a new datagram of size", msg.buf.size());
       auto& st = self->state;
+      auto now = stopwatch::now();
       auto t = timer::start(st.measurement_);
       auto capacity = st.mgr->out().capacity();
       if (capacity == 0) {
@@ -129,9 +133,14 @@ caf::behavior datagram_source(datagram_source_actor<Reader>* self,
         VAST_DEBUG(self, "produced a slice with", slice->rows(), "rows");
         st.mgr->out().push(std::move(slice));
       };
-      auto [err, produced] = st.reader.read(capacity * table_slice_size,
-                                            table_slice_size, push_slice);
+      auto [err, produced] = st.reader.read(st.sizer.batch_size(capacity),
+                                            st.sizer.size(), push_slice);
       t.stop(produced);
+      // Parsing a datagram takes no time compared to waiting for it, so we
+      // measure the rate between the arrival of two datagrams.
+      if (st.last_datagram != stopwatch::time_point::min())
+        st.sizer.update(produced, now - st.last_datagram);
+      st.last_datagram = now;
       if (err != caf::none && err != ec::end_of_input)
         VAST_WARNING(self,
                      "has not enough capacity left in stream, dropping input!");
@@ -13,7 +13,7 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <map>
 #include <vector>
 
 #include <caf/actor.hpp>
@@ -27,6 +27,38 @@
 
 namespace vast::system {
 
+/// A node in the expression tree of an EVALUATOR. Each node caches the hits
+/// of its subexpression, so that the final result of a predicate only
+/// requires updating the nodes on the path to the root.
+/// @relates evaluator_state
+struct evaluator_node {
+  /// Identifies the operation of a node.
+  enum class kind { none, conjunction, disjunction, negation, predicate };
+
+  /// The operation of this node.
+  kind op;
+
+  /// The index of the parent node. The root is its own parent.
+  size_t parent;
+
+  /// The indexes of the operands.
+  std::vector<size_t> children;
+
+  /// The number of operands without final hits. For leaves, this is 1 until
+  /// the result of the predicate arrived.
+  size_t pending;
+
+  /// The hits of the subexpression so far. Conjunctions remain empty until
+  /// all operands have their final hits or one operand has final hits
+  /// without any 1-bit. Negations remain empty until their operand has final
+  /// hits.
+  ids hits;
+
+  /// Whether `hits` is final. A final node ignores all further updates of
+  /// its operands.
+  bool complete = false;
+};
+
 /// @relates evaluator
 struct evaluator_state {
   using predicate_hits_map = std::map<offset, std::pair<size_t, ids>>;
@@ -43,8 +75,13 @@ struct evaluator_state {
   /// tree.
   void handle_missing_result(const offset& position, const caf::error& err);
 
-  /// Evaluates the predicate-tree and may produces new deltas.
-  void evaluate();
+  /// Updates the expression tree with the final hits of the predicate at
+  /// `position` and may produce new deltas.
+  void evaluate(const offset& position);
+
+  /// Updates the ancestors of the node at `index` after its hits changed or
+  /// became final, and sends new hits of the expression to the client.
+  void propagate(size_t index);
 
   /// Decrements the `pending_responses` and sends 'done' to the client when it
   /// reaches 0.
@@ -59,8 +96,15 @@ struct evaluator_state {
   /// Stores hits per predicate in the expression.
   predicate_hits_map predicate_hits;
 
-  /// Stores hits for the expression.
-  ids hits;
+  /// Stores the expression tree in pre-order, i.e., the root comes first.
+  std::vector<evaluator_node> nodes;
+
+  /// Maps the position of each predicate to its node.
+  std::map<offset, size_t> predicate_nodes;
+
+  /// Stores hits for the expression in a Roaring bitmap, which keeps the
+  /// differences sent to the client in the same sparse representation.
+  ids hits = roaring_bitmap{};
 
   /// Points to the parent actor.
   caf::event_based_actor* self;
@@ -78,8 +122,9 @@ struct evaluator_state {
   static inline const char* name = "evaluator";
 };
 
-/// Wraps a query expression in an actor. Upon receiving hits from INDEXER
-/// actors, re-evaluates the expression and relays new hits to its sinks.
+/// Wraps a query expression in an actor. Upon receiving all hits for a
+/// predicate from INDEXER actors, updates the affected part of the expression
+/// and relays new hits to its sinks.
 /// @pre `!eval.empty()`
 caf::behavior evaluator(caf::stateful_actor<evaluator_state>* self,
                         expression expr, evaluation_map eval);
@@ -17,6 +17,7 @@
 #include <deque>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "vast/aliases.hpp"
 #include "vast/event.hpp"
@@ -36,7 +37,9 @@ struct exporter_state {
   caf::actor index;
   caf::actor sink;
   accountant_type accountant;
-  ids hits;
+  /// The union of all hits so far. Hits of a query tend to be sparse and
+  /// scattered, so we accumulate them in a Roaring bitmap.
+  ids hits = roaring_bitmap{};
   std::unordered_map<type, expression> checkers;
   std::deque<event> candidates;
   std::vector<event> results;
@@ -44,6 +44,7 @@
 #include "vast/system/accountant.hpp"
 #include "vast/system/atoms.hpp"
 #include "vast/system/instrumentation.hpp"
+#include "vast/system/table_slice_sizer.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/table_slice_builder.hpp"
 #include "vast/table_slice_builder_factory.hpp"
@@ -105,15 +106,40 @@ struct source_state {
   /// Stores whether `reader` is constructed.
   bool initialized;
 
+  /// Chooses the number of rows per table slice.
+  table_slice_sizer sizer{defaults::system::table_slice_size,
+                          defaults::system::table_slice_max_size,
+                          timespan::zero()};
+
   // -- utility functions ------------------------------------------------------
 
   /// Initializes the state.
-  void init(Reader rd, vast::factory<table_slice_builder>::signature f) {
+  void init(Reader rd, vast::factory<table_slice_builder>::signature f,
+            size_t table_slice_size) {
     // Initialize members from given arguments.
     name = reader.name();
     factory = f;
     new (&reader) Reader(std::move(rd));
     initialized = true;
+    auto& cfg = self->system().config();
+    auto max_size = get_or(cfg, "vast.table-slice-max-size",
+                           defaults::system::table_slice_max_size);
+    auto deadline = get_or(cfg, "vast.table-slice-deadline",
+                           timespan{defaults::system::table_slice_deadline});
+    sizer = table_slice_sizer{table_slice_size, max_size, deadline};
+  }
+
+  /// Reads up to `num` table slices from the reader, letting `sizer` pick
+  /// the number of rows per slice and adapting it to the measured rate.
+  template <class F>
+  auto read(size_t num, F push_slice) {
+    auto start = stopwatch::now();
+    auto t = timer::start(measurement_);
+    auto result = reader.read(sizer.batch_size(num), sizer.size(), push_slice);
+    auto produced = result.second;
+    t.stop(produced);
+    sizer.update(produced, stopwatch::now() - start);
+    return result;
   }
 
   /// Tries to access the builder for `layout`.
@@ -143,6 +169,8 @@ struct source_state {
       auto r = performance_report{{{std::string{name}, measurement_}}};
       measurement_ = measurement{};
       self->send(accountant, std::move(r));
+      auto key = std::string{name} + ".table-slice-size";
+      self->send(accountant, report{{std::move(key), uint64_t{sizer.size()}}});
     }
   }
 };
@@ -160,7 +188,7 @@ caf::behavior source(caf::stateful_actor<source_state<Reader>>* self,
   using namespace std::chrono;
   namespace defs = defaults::system;
   // Initialize state.
-  self->state.init(std::move(reader), factory);
+  self->state.init(std::move(reader), factory, table_slice_size);
   // Spin up the stream manager for the source.
   self->state.mgr = self->make_continuous_source(
     // init
@@ -172,17 +200,15 @@ caf::behavior source(caf::stateful_actor<source_state<Reader>>* self,
     // get next element
     [=](bool& done, downstream<table_slice_ptr>& out, size_t num) {
       auto& st = self->state;
-      auto t = timer::start(st.measurement_);
       // Extract events until the source has exhausted its input or until
       // we have completed a batch.
       auto push_slice = [&](table_slice_ptr x) { out.push(std::move(x)); };
-      // We can produce up to num * table_slice_size events per run.
-      auto [err,produced] = st.reader.read(num * table_slice_size,
-                                         table_slice_size, push_slice);
+      // We can produce up to num slices per run, but produce fewer when
+      // they would not fill up within the deadline.
+      auto [err, produced] = st.read(num, push_slice);
       // TODO: if the source is unable to generate new events (returns 0)
       //       then we should trigger CAF to poll the source after a
       //       predefined interval of time again, e.g., via delayed_send
-      t.stop(produced);
       if (err != caf::none) {
         done = true;
         st.send_report();
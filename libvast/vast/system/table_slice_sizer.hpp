@@ -0,0 +1,75 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+
+#include "vast/time.hpp"
+
+namespace vast::system {
+
+/// Chooses the number of rows per table slice for a source. Under load, the
+/// sizer grows slices toward a ceiling to amortize the per-message costs of
+/// all downstream stages. When events trickle in, it shrinks slices so that
+/// a slice fills up within a latency deadline. The sizer tracks the event
+/// rate of the source as an exponentially weighted moving average and picks
+/// the number of rows that arrive within the deadline at that rate.
+class table_slice_sizer {
+public:
+  /// The weight of a new rate sample in the moving average.
+  static constexpr double smoothing = 0.25;
+
+  /// Constructs a sizer.
+  /// @param size The number of rows per table slice before the first rate
+  ///        sample arrives.
+  /// @param max_size The maximum number of rows per table slice.
+  /// @param deadline The time that a slice may take to fill up. A zero
+  ///        deadline disables adaptation and keeps slices at *size*.
+  table_slice_sizer(size_t size, size_t max_size, timespan deadline);
+
+  /// @returns the current number of rows per table slice.
+  size_t size() const noexcept {
+    return size_;
+  }
+
+  /// @returns the maximum number of rows per table slice.
+  size_t max_size() const noexcept {
+    return max_size_;
+  }
+
+  /// @returns the measured event rate in events per second.
+  double rate() const noexcept {
+    return rate_;
+  }
+
+  /// Computes the number of events to read at once.
+  /// @param num The number of slices that downstream can accept.
+  /// @returns the number of events for as many slices of the current size as
+  ///          fit into *num* and fill up within the deadline.
+  size_t batch_size(size_t num) const noexcept;
+
+  /// Adds a rate sample and adapts the slice size.
+  /// @param events The number of events that the source produced.
+  /// @param elapsed The time it took to produce *events*.
+  void update(size_t events, timespan elapsed);
+
+private:
+  size_t max_size_;
+  timespan deadline_;
+  size_t size_;
+  double rate_ = 0;
+  bool sampled_ = false;
+};
+
+} // namespace vast::system
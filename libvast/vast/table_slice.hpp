@@ -123,6 +123,16 @@ public:
   /// @pre `row < rows() && col < columns()`
   virtual data_view at(size_type row, size_type col) const = 0;
 
+  // -- projection -------------------------------------------------------------
+
+  /// Creates a table slice that consists of a subset of the columns. The
+  /// default implementation copies the selected columns with a builder for
+  /// the same implementation.
+  /// @param columns The offsets of the columns to keep in increasing order.
+  /// @returns A new slice with the same offset and the selected columns.
+  /// @pre `!columns.empty()` and `columns.back() < columns()`
+  virtual table_slice_ptr project(const std::vector<size_type>& columns) const;
+
 protected:
   // -- member variables -------------------------------------------------------
 
@@ -143,6 +153,48 @@ expected<std::vector<table_slice_ptr>>
 make_random_table_slices(size_t num_slices, size_t slice_size,
                          record_type layout, id offset = 0, size_t seed = 0);
 
+/// Selects all rows in *xs* with event IDs in *selection* and appends them to
+/// *result*. Because a table slice covers a contiguous ID range, the function
+/// produces one table slice per contiguous run of selected IDs. Each of them
+/// shares the cells of *xs* rather than copying them. When *selection*
+/// contains all rows of *xs*, the function appends *xs* itself.
+/// @param result The container for the selected rows.
+/// @param xs The input table slice.
+/// @param selection ID set for selecting events from *xs*.
+/// @relates table_slice
+void select(std::vector<table_slice_ptr>& result, const table_slice_ptr& xs,
+            const ids& selection);
+
+/// Selects all rows in *xs* with event IDs in *selection*.
+/// @param xs The input table slice.
+/// @param selection ID set for selecting events from *xs*.
+/// @returns table slices covering the contiguous runs in *selection*.
+/// @relates table_slice
+std::vector<table_slice_ptr> select(const table_slice_ptr& xs,
+                                    const ids& selection);
+
+/// Restricts *xs* to a subset of its columns. Offsets beyond the number of
+/// columns of *xs* are ignored, so that a single projection can apply to
+/// slices of different layouts. The result shares the cells of *xs* and
+/// copies the selected columns only when serialized.
+/// @param xs The input table slice.
+/// @param columns The offsets of the columns to keep in increasing order. An
+///        empty projection selects all columns.
+/// @returns *xs* itself if the projection selects all columns, `nullptr` if
+///          it selects none, and a handle to the selected columns otherwise.
+/// @relates table_slice
+table_slice_ptr project(const table_slice_ptr& xs,
+                        const std::vector<size_t>& columns);
+
+/// Changes the ID offset of a table slice without copying its cells. If *xs*
+/// is shared, the result is a lightweight handle with its own header that
+/// refers to the cells of *xs*.
+/// @param xs The input table slice.
+/// @param offset The new offset.
+/// @returns a table slice with the cells of *xs* at *offset*.
+/// @relates table_slice
+table_slice_ptr rebase(table_slice_ptr xs, id offset);
+
 /// @relates table_slice
 bool operator==(const table_slice& x, const table_slice& y);
 
@@ -25,6 +25,12 @@ namespace vast {
 /// @relates table_slice
 class table_slice_builder : public caf::ref_counted {
 public:
+  // -- constants --------------------------------------------------------------
+
+  /// The maximum number of finished slices whose storage a builder keeps for
+  /// reuse after the slices get destroyed.
+  static constexpr size_t max_recycled_slices = 16;
+
   // -- constructors, destructors, and assignment operators --------------------
 
   table_slice_builder(record_type layout);
@@ -15,15 +15,23 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include <caf/deserializer.hpp>
 #include <caf/error.hpp>
 #include <caf/serializer.hpp>
+#include <caf/variant.hpp>
 
 #include "vast/ewah_bitmap.hpp"
 #include "vast/ids.hpp"
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/bitmap_index.hpp"
+#include "vast/bitvector.hpp"
+#include "vast/concept/hashable/xxhash.hpp"
 #include "vast/concept/printable/vast/data.hpp"
 #include "vast/concept/printable/vast/operator.hpp"
 #include "vast/detail/assert.hpp"
@@ -31,14 +39,86 @@
 #include "vast/die.hpp"
 #include "vast/error.hpp"
 #include "vast/expected.hpp"
+#include "vast/span.hpp"
 #include "vast/type.hpp"
 #include "vast/value_index_factory.hpp"
 #include "vast/view.hpp"
+#include "vast/word.hpp"
 
 namespace vast {
 
 using value_index_ptr = std::unique_ptr<value_index>;
 
+/// A contiguous range of column values for appending to a value index in
+/// bulk. Columns of basic types pass their values as a typed array, which
+/// lets an index process the whole range without dispatching on every value.
+/// All other columns pass a sequence of views.
+struct column_batch {
+  using values_type = caf::variant<
+    std::vector<data_view>,
+    span<const integer>,
+    span<const count>,
+    span<const real>,
+    span<const timespan>,
+    span<const timestamp>,
+    span<const port>,
+    span<const address>
+  >;
+
+  /// The values of the batch.
+  values_type values;
+
+  /// Has a bit set for every position that holds a value. If null, every
+  /// position holds a value unless it is a nil view. If set, the bitmap is
+  /// authoritative and values at cleared positions are ignored.
+  const bitvector<uint64_t>* valid = nullptr;
+
+  /// @returns the number of positions in the batch.
+  size_t size() const;
+
+  /// @returns whether position *i* holds a value, i.e., is not nil.
+  bool is_valid(size_t i) const;
+
+  /// @returns the value at position *i*.
+  data_view at(size_t i) const;
+
+  /// Computes the validity of a block of positions at once.
+  /// @param i The index of the block.
+  /// @returns a word with bit *k* set iff position `i * 64 + k` holds a value.
+  ///          Bits of positions past the end of the batch are cleared.
+  uint64_t valid_block(size_t i) const;
+
+  /// Invokes *f* with the bounds `[first, last)` of every maximal range of
+  /// positions that hold a value.
+  template <class F>
+  void each_valid_range(F f) const {
+    using word_type = word<uint64_t>;
+    auto n = size();
+    auto first = size_t{0};
+    auto in_range = false;
+    for (size_t base = 0; base < n; base += word_type::width) {
+      auto block = valid_block(base / word_type::width);
+      auto bits = std::min(n - base, size_t{word_type::width});
+      // Skip from one boundary between valid and nil positions to the next.
+      for (size_t k = 0; k < bits;) {
+        auto rest = block >> k;
+        auto run = in_range ? word_type::count_trailing_ones(rest)
+                            : word_type::count_trailing_zeros(rest);
+        k = std::min(k + run, bits);
+        if (k == bits)
+          break;
+        if (in_range)
+          f(first, base + k);
+        else
+          first = base + k;
+        in_range = !in_range;
+      }
+    }
+    if (in_range)
+      f(first, n);
+  }
+};
+
 /// An index for a ::value that supports appending and looking up values.
 /// @warning A lookup result does *not include* `nil` values, regardless of the
 /// relational operator. Include them requires performing an OR of the result
@@ -62,6 +142,12 @@ public:
   /// @returns `true` if appending succeeded.
   expected<void> append(data_view x, id pos);
 
+  /// Appends a batch of consecutive values.
+  /// @param xs The values to append to the index.
+  /// @param first The positional identifier of the first value in *xs*.
+  /// @returns An error if appending failed.
+  expected<void> append(const column_batch& xs, id first);
+
   /// Looks up data under a relational operator. If the value to look up is
   /// `nil`, only `==` and `!=` are valid operations. The concrete index
   /// type determines validity of other values.
@@ -88,6 +174,11 @@ public:
 
   virtual caf::error deserialize(caf::deserializer& source);
 
+protected:
+  /// Appends the non-nil values of a batch. The default implementation calls
+  /// `append_impl` for every value.
+  virtual bool append_batch_impl(const column_batch& xs, id first);
+
 private:
   virtual bool append_impl(data_view x, id pos) = 0;
 
@@ -116,32 +207,33 @@ namespace detail {
 template <class Index, class Sequence>
 expected<ids> container_lookup_impl(const Index& idx, relational_operator op,
                                const Sequence& xs) {
-  ids result;
-  if (op == in) {
-    result = bitmap{idx.offset(), false};
-    for (auto x : xs) {
-      auto r = idx.lookup(equal, x);
-      if (r)
-        result |= *r;
-      else
-        return r;
-      if (all<1>(result)) // short-circuit
-        return result;
-    }
-  } else if (op == not_in) {
-    result = bitmap{idx.offset(), true};
-    for (auto x : xs) {
-      auto r = idx.lookup(equal, x);
-      if (r)
-        result -= *r;
-      else
-        return r;
-      if (all<0>(result)) // short-circuit
-        return result;
-    }
-  } else {
+  if (op != in && op != not_in)
     return make_error(ec::unsupported_operator, op);
+  // Combine the hits of the elements in batches, and stop looking up further
+  // elements once the union of the hits covers all IDs.
+  constexpr size_t batch_size = 16;
+  std::vector<ids> hits;
+  hits.reserve(std::min<size_t>(xs.size(), batch_size) + 1);
+  hits.emplace_back(idx.offset(), false);
+  for (auto x : xs) {
+    auto r = idx.lookup(equal, x);
+    if (!r)
+      return r;
+    hits.push_back(std::move(*r));
+    if (hits.size() > batch_size) {
+      auto partial = nary_or(hits.begin(), hits.end());
+      if (all<1>(partial)) { // short-circuit
+        if (op == not_in)
+          return bitmap{idx.offset(), false};
+        return partial;
+      }
+      hits.clear();
+      hits.push_back(std::move(partial));
+    }
   }
+  auto result = nary_or(hits.begin(), hits.end());
+  if (op == not_in)
+    return bitmap{idx.offset(), true} - result;
   return result;
 }
 
@@ -225,6 +317,29 @@ public:
   }
 
 private:
+  bool append_batch_impl(const column_batch& xs, id first) override {
+    if constexpr (!std::is_same_v<T, boolean>) {
+      if (auto values = caf::get_if<span<const T>>(&xs.values)) {
+        xs.each_valid_range([&](size_t i, size_t j) {
+          bmi_.skip(first + i - bmi_.size());
+          bmi_.append(values->data() + i, values->data() + j,
+                      [](T x) { return to_value(x); });
+        });
+        return true;
+      }
+    }
+    return value_index::append_batch_impl(xs, first);
+  }
+
+  static value_type to_value(T x) {
+    if constexpr (std::is_same_v<T, timespan>)
+      return x.count();
+    else if constexpr (std::is_same_v<T, timestamp>)
+      return x.time_since_epoch().count();
+    else
+      return x;
+  }
+
   bool append_impl(data_view d, id pos) override {
     auto append = [&](auto x) {
       bmi_.skip(pos - bmi_.size());
@@ -273,7 +388,12 @@ public:
   /// @param t An instance of `string_type`.
   /// @param max_length The maximum string length to support. Longer strings
   ///                   will be chopped to this size.
-  explicit string_index(vast::type t, size_t max_length = 1024);
+  /// @param trigrams Whether to maintain a trigram index, which accelerates
+  ///                 substring queries at the cost of additional space. Only
+  ///                 indexes with trigrams serialize them, so deserializing
+  ///                 requires an index constructed with the same setting.
+  explicit string_index(vast::type t, size_t max_length = 1024,
+                        bool trigrams = false);
 
   caf::error serialize(caf::serializer& sink) const override;
 
@@ -287,6 +407,9 @@ private:
   using length_bitmap_index =
     bitmap_index<uint32_t, multi_level_coder<range_coder<ids>>>;
 
+  /// Maps three consecutive characters to the strings that contain them.
+  using trigram_map = std::unordered_map<uint32_t, ewah_bitmap>;
+
   void init();
 
   bool append_impl(data_view x, id pos) override;
@@ -294,9 +417,56 @@ private:
   expected<ids>
   lookup_impl(relational_operator op, data_view x) const override;
 
+  /// Looks up the strings that contain a given string of at least three
+  /// characters.
+  ids substring_lookup(std::string_view str) const;
+
   size_t max_length_;
   length_bitmap_index length_;
   std::vector<char_bitmap_index> chars_;
+  bool trigrams_enabled_;
+  trigram_map trigrams_;
+};
+
+/// An index for strings that supports equality queries only. It maps the
+/// digest of each distinct string to the positions where it occurs, so that
+/// a lookup costs a single hash table probe, independent of the string
+/// length. This suits high-cardinality columns, such as hostnames or URIs.
+/// The index keeps the distinct strings to tell apart strings with the same
+/// digest.
+class hash_index : public value_index {
+public:
+  using value_index::value_index;
+
+  caf::error serialize(caf::serializer& sink) const override;
+
+  caf::error deserialize(caf::deserializer& source) override;
+
+private:
+  using digest_type = xxhash64::result_type;
+
+  /// A distinct string and its positions.
+  struct entry {
+    std::string value;
+    ewah_bitmap positions;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, entry& x) {
+      return f(x.value, x.positions);
+    }
+  };
+
+  /// Maps a digest to the distinct strings with that digest.
+  using digest_map = std::unordered_map<digest_type, std::vector<entry>>;
+
+  static digest_type digest(std::string_view str);
+
+  bool append_impl(data_view x, id pos) override;
+
+  expected<ids>
+  lookup_impl(relational_operator op, data_view x) const override;
+
+  digest_map values_;
 };
 
 /// An index for IP addresses.
@@ -314,6 +484,8 @@ public:
 private:
   void init();
 
+  bool append_batch_impl(const column_batch& xs, id first) override;
+
   bool append_impl(data_view x, id pos) override;
 
   expected<ids>
@@ -370,6 +542,8 @@ public:
 private:
   void init();
 
+  bool append_batch_impl(const column_batch& xs, id first) override;
+
   bool append_impl(data_view x, id pos) override;
 
   expected<ids>
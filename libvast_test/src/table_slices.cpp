@@ -18,6 +18,7 @@
 #include "vast/chunk.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/data.hpp"
+#include "vast/ids.hpp"
 #include "vast/span.hpp"
 #include "vast/table_slice_factory.hpp"
 #include "vast/value_index.hpp"
@@ -74,6 +75,7 @@ void table_slices::run() {
   test_message_serialization();
   test_load_from_chunk();
   test_append_column_to_index();
+  test_select();
 }
 
 caf::binary_deserializer table_slices::make_source() {
@@ -193,4 +195,24 @@ void table_slices::test_append_column_to_index() {
   CHECK_EQUAL(unbox(idx->lookup(less, make_view(3))), make_ids({1}));
 }
 
+void table_slices::test_select() {
+  MESSAGE(">> test select");
+  auto slice = make_slice();
+  slice.unshared().offset(100);
+  MESSAGE("select all rows");
+  auto xs = select(slice, make_ids({{90, 110}}));
+  REQUIRE_EQUAL(xs.size(), 1u);
+  CHECK(xs[0] == slice);
+  MESSAGE("select a single row");
+  xs = select(slice, make_ids({101}));
+  REQUIRE_EQUAL(xs.size(), 1u);
+  CHECK_EQUAL(xs[0]->offset(), 101u);
+  CHECK_EQUAL(xs[0]->rows(), 1u);
+  CHECK_EQUAL(xs[0]->implementation_id(), builder->implementation_id());
+  for (size_t col = 0; col < slice->columns(); ++col)
+    CHECK_EQUAL(xs[0]->at(0, col), at(1, col));
+  MESSAGE("select no row");
+  CHECK(select(slice, make_ids({42})).empty());
+}
+
 } // namespace fixtures
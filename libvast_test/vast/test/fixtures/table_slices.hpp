@@ -85,6 +85,8 @@ private:
 
   void test_append_column_to_index();
 
+  void test_select();
+
   vast::record_type layout;
 
   vast::table_slice_builder_ptr builder;